@@ -13,7 +13,7 @@ void test_pair(size_t test_size, size_t test_round, Op op, std::string sort_name
 	using namespace std;
 	uniform_int_distribution<p1> rnd1;
 	uniform_int_distribution<p2> rnd2;
-	int used_time = 0;
+	double used_time = 0;
 	vector<pair<p1, p2>> ar;
 	ar.resize(test_size + 1);
 	for (size_t i = 0; i < test_round; ++i)
@@ -25,7 +25,7 @@ void test_pair(size_t test_size, size_t test_round, Op op, std::string sort_name
 		}
 		auto beg = chrono::high_resolution_clock::now();
 		op(ar.begin(), ar.end());
-		used_time += (chrono::high_resolution_clock::now() - beg) / 1ms;
+		used_time += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - beg).count();
 	}
 	cout << "|" << sort_name << "|" << used_time / test_round << "ms" << "|\n";
 }
@@ -34,8 +34,8 @@ template<typename T, typename Op>
 void test(size_t test_size, size_t test_round, Op op, std::string sort_name)
 {
 	using namespace std;
-	uniform_int_distribution<T> rnd;
-	int used_time = 0;
+	conditional_t<is_floating_point_v<T>, uniform_real_distribution<T>, uniform_int_distribution<T>> rnd;
+	double used_time = 0;
 	vector<T> ar;
 	ar.resize(test_size + 1);
 	for (size_t i = 0; i < test_round; ++i)
@@ -47,22 +47,13 @@ void test(size_t test_size, size_t test_round, Op op, std::string sort_name)
 		}
 		auto beg = chrono::high_resolution_clock::now();
 		op(ar.begin(), ar.end());
-		used_time += (chrono::high_resolution_clock::now() - beg) / 1ms;
+		used_time += chrono::duration<double, milli>(chrono::high_resolution_clock::now() - beg).count();
 	}
 	cout << "|" << sort_name << "|" << used_time / test_round << "ms" << "|\n";
 }
 
 template<typename p1, typename p2>
-struct one_key
-{
-	static constexpr std::size_t radix_size = sizeof(p1) / sizeof(unsigned char);
-	template <size_t index>
-	static unsigned char get(const std::pair<p1, p2>& obj) noexcept
-	{
-		static_assert(index < radix_size);
-		return radix_trait<p1>::template get<index>(obj.first);
-	}
-};
+using one_key = radix_trait_fields<std::pair<p1, p2>, radix_field<&std::pair<p1, p2>::first>>;
 
 int main()
 {
@@ -86,6 +77,14 @@ int main()
 		test<int>(test_size, test_round, [](const auto& a, const auto& b) {sort(execution::par, a, b); }, "std::sort(par)");
 		test<int>(test_size, test_round, [](const auto& a, const auto& b) {stable_sort(execution::par, a, b); }, "std::stable_sort(par)");
 		test<int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b, execution::par); }, "radix_sort(par)");
+		test<int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<radix_trait_bits<11, radix_trait<int>>>(a, b); }, "radix_sort(11bit)");
+		test<int>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<radix_trait_bits<16, radix_trait<int>>>(a, b); }, "radix_sort(16bit)");
+
+		cout << "\nRun sort on float vector with " << test_size << " elements: " << endl;
+		test<float>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b); }, "std::sort");
+		test<float>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort(a, b); }, "radix_sort");
+		test<float>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<radix_trait_bits<11, radix_trait<float>>>(a, b); }, "radix_sort(11bit)");
+		test<float>(test_size, test_round, [](const auto& a, const auto& b) {radix_sort<radix_trait_bits<16, radix_trait<float>>>(a, b); }, "radix_sort(16bit)");
 
 		cout << "\nRun sort on size_t vector with " << test_size << " elements: " << endl;
 		test<size_t>(test_size, test_round, [](const auto& a, const auto& b) {sort(a, b); }, "std::sort");
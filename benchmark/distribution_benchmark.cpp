@@ -0,0 +1,314 @@
+//Sorts every input distribution with radix_sort and the std baselines, reporting ns/element and GB/s with their spread.
+//
+//usage: distribution_benchmark [--min-size N] [--max-size N] [--threads 1,2,4] [--rounds N]
+//                              [--dist NAME] [--type NAME] [--sort NAME] [--json FILE]
+//sizes go up by 10x from --min-size (1e3) to --max-size (1e7, 1e9 needs about 3x the input in memory),
+//--dist/--type/--sort keep the cases whose name contains the argument.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <compare>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+#include <tbb/global_control.h>
+
+#include "radix_sort.hpp"
+
+//A large element sorted by a 64-bit key
+struct record
+{
+	uint64_t key;
+	char payload[56];
+};
+
+struct record_trait
+{
+	static constexpr std::size_t radix_size = sizeof(uint64_t);
+	template <size_t index>
+	static uint8_t get(const record& obj) noexcept
+	{
+		return radix_trait<uint64_t>::template get<index>(obj.key);
+	}
+};
+
+//Order used by the comparison sorts, floats follow the IEEE754 total order as radix_sort does
+template <typename T>
+bool key_less(const T& a, const T& b)
+{
+	if constexpr (std::is_same_v<T, record>)
+		return a.key < b.key;
+	else if constexpr (std::is_floating_point_v<T>)
+		return std::strong_order(a, b) < 0;
+	else
+		return a < b;
+}
+
+struct options
+{
+	double min_size = 1e3, max_size = 1e7;
+	std::vector<unsigned int> threads;
+	size_t rounds = 0;
+	std::string dist, type, sort, json;
+};
+
+struct result
+{
+	std::string dist, type, sort;
+	size_t size, rounds;
+	unsigned int threads;
+	double mean_ns, stddev_ns, min_ns, gbps;
+};
+
+const char* distributions[] = { "uniform", "sorted", "reverse", "nearly_sorted", "few_unique", "narrow_range", "zipf",
+	"constant_high_bytes", "special_values" };
+
+//Key of rank k out of a Zipf(1.1) distribution over 2^20 values, scrambled so that ranks do not sort in order
+uint64_t zipf_key(std::mt19937_64& rng)
+{
+	using namespace std;
+	static const vector<double> cdf = [] {
+		vector<double> cdf(1 << 20);
+		double sum = 0;
+		for (size_t k = 0; k < cdf.size(); ++k)
+			cdf[k] = sum += 1 / pow(double(k + 1), 1.1);
+		for (auto& c : cdf)
+			c /= sum;
+		return cdf;
+	}();
+	auto rank = lower_bound(cdf.begin(), cdf.end(), uniform_real_distribution<double>(0, 1)(rng)) - cdf.begin();
+	return uint64_t(rank) * 0x9E3779B97F4A7C15ull;
+}
+
+template <typename T>
+T make_key(uint64_t bits)
+{
+	if constexpr (std::is_same_v<T, record>)
+	{
+		record obj{ bits, {} };
+		memcpy(obj.payload, &bits, sizeof(bits));
+		return obj;
+	}
+	else if constexpr (std::is_floating_point_v<T>)
+		return T(double(int64_t(bits)) / 1e3);
+	else
+		return T(bits);
+}
+
+//Input of size n drawn from dist, empty when the distribution does not apply to T
+template <typename T>
+std::vector<T> generate(const std::string& dist, size_t n)
+{
+	using namespace std;
+	mt19937_64 rng(114514);
+	vector<T> ar(n);
+	if (dist == "special_values")
+	{
+		//negatives, signed zeros, infinities and NaNs mixed into uniform floats
+		if constexpr (!is_floating_point_v<T>)
+			return {};
+		else
+		{
+			for (auto& x : ar)
+			{
+				auto pick = rng() % 100;
+				if (pick == 0)
+					x = numeric_limits<T>::quiet_NaN() * (rng() % 2 ? 1 : -1);
+				else if (pick == 1)
+					x = numeric_limits<T>::infinity() * (rng() % 2 ? 1 : -1);
+				else if (pick == 2)
+					x = rng() % 2 ? T(0) : -T(0);
+				else
+					x = uniform_real_distribution<T>(-1e6, 1e6)(rng);
+			}
+			return ar;
+		}
+	}
+	if (dist == "zipf")
+		for (auto& x : ar)
+			x = make_key<T>(zipf_key(rng) >> (64 - 8 * min<size_t>(sizeof(T), 8)));
+	else if (dist == "few_unique")
+		for (auto& x : ar)
+			x = make_key<T>((rng() % 16) * 0x0101010101010101ull);
+	else if (dist == "narrow_range")
+		for (auto& x : ar)
+			x = make_key<T>(rng() % 1024);
+	else if (dist == "constant_high_bytes")
+		for (auto& x : ar)
+			x = make_key<T>((0x5A5Aull << (8 * min<size_t>(sizeof(T), 8) - 16)) | (rng() & 0xFFFF));
+	else
+		for (auto& x : ar)
+			x = make_key<T>(rng());
+	if (dist == "sorted" || dist == "reverse" || dist == "nearly_sorted")
+		sort(ar.begin(), ar.end(), key_less<T>);
+	if (dist == "reverse")
+		reverse(ar.begin(), ar.end());
+	if (dist == "nearly_sorted")
+		for (size_t k = 0; k < n / 100; ++k)
+			swap(ar[rng() % n], ar[rng() % n]);
+	return ar;
+}
+
+//A sort under test, threads is 0 for the sequential ones
+template <typename T>
+struct sort_case
+{
+	std::string name;
+	bool parallel;
+	std::function<void(std::vector<T>&, unsigned int, radix_thread_pool&)> run;
+};
+
+template <typename T>
+std::vector<sort_case<T>> sort_cases()
+{
+	using namespace std;
+	using Trait = conditional_t<is_same_v<T, record>, record_trait, radix_trait<T>>;
+	vector<sort_case<T>> cases = {
+		{ "std::sort", false, [](vector<T>& ar, unsigned int, radix_thread_pool&) { sort(ar.begin(), ar.end(), key_less<T>); } },
+		{ "std::stable_sort", false, [](vector<T>& ar, unsigned int, radix_thread_pool&) { stable_sort(ar.begin(), ar.end(), key_less<T>); } },
+		{ "radix_sort", false, [](vector<T>& ar, unsigned int, radix_thread_pool&) { radix_sort<Trait>(ar.begin(), ar.end()); } },
+		{ "msd_radix_sort", false, [](vector<T>& ar, unsigned int, radix_thread_pool&) { msd_radix_sort<Trait>(ar.begin(), ar.end()); } },
+		{ "std::sort(par)", true, [](vector<T>& ar, unsigned int threads, radix_thread_pool&) {
+			tbb::global_control limit(tbb::global_control::max_allowed_parallelism, threads);
+			sort(execution::par, ar.begin(), ar.end(), key_less<T>); } },
+		{ "parallel_radix_sort", true, [](vector<T>& ar, unsigned int threads, radix_thread_pool& pool) {
+			parallel_radix_sort<Trait>(ar.begin(), ar.end(), nullptr, threads, pool); } },
+		{ "parallel_msd_radix_sort", true, [](vector<T>& ar, unsigned int threads, radix_thread_pool& pool) {
+			parallel_msd_radix_sort<Trait>(ar.begin(), ar.end(), nullptr, threads, pool); } },
+	};
+	if constexpr (is_same_v<T, record>)
+		cases.push_back({ "radix_sort_by_key", false, [](vector<T>& ar, unsigned int, radix_thread_pool&) {
+			radix_sort_by_key(ar.begin(), ar.end(), &record::key); } });
+	return cases;
+}
+
+bool selected(const std::string& name, const std::string& filter)
+{
+	return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+template <typename T>
+void bench_type(const std::string& type, const options& opt, std::vector<result>& results)
+{
+	using namespace std;
+	if (!selected(type, opt.type))
+		return;
+	auto cases = sort_cases<T>();
+	for (auto dist : distributions)
+	{
+		if (!selected(dist, opt.dist))
+			continue;
+		for (double size = opt.min_size; size <= opt.max_size; size *= 10)
+		{
+			auto n = static_cast<size_t>(size);
+			auto input = generate<T>(dist, n);
+			if (input.empty())
+				break;
+			auto rounds = opt.rounds != 0 ? opt.rounds : clamp<size_t>(size_t(1e7 / size), 3, 100);
+			vector<T> ar;
+			for (auto& c : cases)
+			{
+				if (!selected(c.name, opt.sort))
+					continue;
+				for (auto threads : c.parallel ? opt.threads : vector<unsigned int>{ 1 })
+				{
+					radix_thread_pool pool(c.parallel ? threads : 1);
+					vector<double> ns;
+					for (size_t r = 0; r < rounds; ++r)
+					{
+						ar = input;
+						auto beg = chrono::steady_clock::now();
+						c.run(ar, threads, pool);
+						ns.push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - beg).count() / double(n));
+					}
+					if (!is_sorted(ar.begin(), ar.end(), key_less<T>))
+						cerr << "error: " << c.name << " left " << type << "/" << dist << " unsorted\n";
+					double mean = accumulate(ns.begin(), ns.end(), 0.0) / double(rounds), var = 0;
+					for (auto x : ns)
+						var += (x - mean) * (x - mean);
+					result res{ dist, type, c.name, n, rounds, c.parallel ? threads : 0, mean, sqrt(var / double(rounds)),
+						*min_element(ns.begin(), ns.end()), double(sizeof(T)) / mean };
+					printf("|%-20s|%-8s|%10zu|%-24s|%3u|%9.2f ns/elem|+-%6.2f|%8.2f GB/s|\n", res.dist.c_str(), res.type.c_str(),
+						res.size, res.sort.c_str(), res.threads, res.mean_ns, res.stddev_ns, res.gbps);
+					results.push_back(res);
+				}
+			}
+		}
+	}
+}
+
+void write_json(const std::string& path, const std::vector<result>& results)
+{
+	using namespace std;
+	ofstream out(path);
+	out << "{\n  \"hardware_concurrency\": " << thread::hardware_concurrency() << ",\n  \"results\": [\n";
+	for (size_t k = 0; k < results.size(); ++k)
+	{
+		auto& r = results[k];
+		char line[512];
+		snprintf(line, sizeof(line), "    {\"distribution\": \"%s\", \"type\": \"%s\", \"sort\": \"%s\", \"size\": %zu, "
+			"\"threads\": %u, \"rounds\": %zu, \"ns_per_element\": %.4f, \"stddev_ns_per_element\": %.4f, "
+			"\"min_ns_per_element\": %.4f, \"gb_per_s\": %.4f}%s\n", r.dist.c_str(), r.type.c_str(), r.sort.c_str(), r.size,
+			r.threads, r.rounds, r.mean_ns, r.stddev_ns, r.min_ns, r.gbps, k + 1 < results.size() ? "," : "");
+		out << line;
+	}
+	out << "  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	using namespace std;
+	options opt;
+	for (int k = 1; k + 1 < argc; k += 2)
+	{
+		string key = argv[k], value = argv[k + 1];
+		if (key == "--min-size")
+			opt.min_size = stod(value);
+		else if (key == "--max-size")
+			opt.max_size = stod(value);
+		else if (key == "--rounds")
+			opt.rounds = stoul(value);
+		else if (key == "--dist")
+			opt.dist = value;
+		else if (key == "--type")
+			opt.type = value;
+		else if (key == "--sort")
+			opt.sort = value;
+		else if (key == "--json")
+			opt.json = value;
+		else if (key == "--threads")
+		{
+			for (size_t pos = 0; pos < value.size();)
+			{
+				auto next = value.find(',', pos);
+				opt.threads.push_back(stoul(value.substr(pos, next - pos)));
+				pos = next == string::npos ? value.size() : next + 1;
+			}
+		}
+		else
+		{
+			cerr << "unknown option " << key << "\n";
+			return 1;
+		}
+	}
+	if (opt.threads.empty())
+		for (auto threads = 2u; threads <= max(2u, thread::hardware_concurrency()); threads *= 2)
+			opt.threads.push_back(threads);
+
+	vector<result> results;
+	bench_type<uint32_t>("uint32", opt, results);
+	bench_type<uint64_t>("uint64", opt, results);
+	bench_type<int64_t>("int64", opt, results);
+	bench_type<float>("float", opt, results);
+	bench_type<double>("double", opt, results);
+	bench_type<record>("record64", opt, results);
+	if (!opt.json.empty())
+		write_json(opt.json, results);
+	return 0;
+}
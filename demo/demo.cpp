@@ -1,5 +1,7 @@
 #include "radix_sort.hpp"
+#include "radix_sort_external.hpp"
 #include <algorithm>
+#include <filesystem>
 #include <iostream>
 
 struct mystruct
@@ -101,5 +103,50 @@ int main()
         radix_sort(ar.begin(),ar.end(),std::execution::par);
         //multi-threads parallel sorting
     }
+    {
+        radix_thread_pool pool(4);
+        std::vector<int> ar{3,5,1,3,6};
+        parallel_radix_sort(ar.begin(),ar.end(),pool);
+        //reuse the same worker threads across parallel sorts
+    }
+    {
+        radix_sorter<int> sorter(4);
+        std::vector<int> ar{3,5,1,3,6};
+        sorter.sort(ar.begin(),ar.end());
+        sorter.sort(ar.begin(),ar.end(),std::execution::par);
+        //keep scratch buffer, counters and threads across batches
+    }
+    {
+        radix_sorter<uint32_t,radix_trait_bits<11,radix_trait<uint32_t>>> sorter(64);
+        std::vector<uint32_t> ar(7000000);
+        for(size_t k=0;k<ar.size();++k) ar[k]=uint32_t(k*2654435761u);
+        sorter.parallel_sort(ar.begin(),ar.end(),64);
+        ar.resize(1700000);
+        for(size_t k=0;k<ar.size();++k) ar[k]=uint32_t(k*2654435761u);
+        sorter.parallel_sort(ar.begin(),ar.end(),17);
+        //later batches may run on fewer threads than the first one
+        std::cout << "Sorter reuse sorted: " << std::is_sorted(ar.begin(),ar.end()) << std::endl;
+    }
+    {
+        std::vector<std::string> ar={"b","abc","ab"};
+        string_radix_sort(ar.begin(),ar.end());
+        //MSD sort of variable-length keys, also for string_view and (const char*,len) pairs
+    }
+    {
+        std::vector<uint64_t> ar={5,3,9,1,7};
+        auto temp=std::filesystem::temp_directory_path();
+        std::string input=temp/"radix_demo_input.bin",output=temp/"radix_demo_output.bin";
+        radix_file(::open(input.c_str(),O_WRONLY|O_CREAT|O_TRUNC,0644)).write(ar.data(),ar.size()*sizeof(uint64_t));
+        radix_external_options opt;
+        opt.memory_budget=size_t(256)<<20;
+        opt.max_open_files=64;
+        opt.temp_dir=temp.string();
+        external_radix_sort<uint64_t>(input,output,opt);
+        //sort a file of fixed-width records larger than memory through bucket files on disk
+        radix_file(::open(output.c_str(),O_RDONLY)).read(ar.data(),ar.size()*sizeof(uint64_t));
+        std::cout << "After external sort: ";   print_vector(ar);
+        std::filesystem::remove(input);
+        std::filesystem::remove(output);
+    }
     return 0;
 }
@@ -7,8 +7,37 @@
 #include <future>
 #include <memory>
 #include <cstring>
+#include <climits>
+#include <utility>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 #include <limits>
 #include <type_traits>
+#include <concepts>
+#include <bit>
+#include <iterator>
+#include <functional>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <stdexcept>
+#include <tuple>
+#include <fstream>
+#include <string>
+#include <string_view>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define RADIX_SORT_AVX2_DISPATCH
+#endif
+#ifdef RADIX_SORT_NUMA
+#include <numa.h>
+#endif
 
 template <typename T>
 class radix_trait;
@@ -26,6 +55,16 @@ struct radix_trait
     {
         static_assert(index < radix_size, "index out of bounds");
 
+#ifdef __SIZEOF_INT128__
+        // 128-bit integer, which the type traits only count as one with GNU extensions: the sign bit flipped
+        if constexpr (std::is_same_v<T, __int128> || std::is_same_v<T, unsigned __int128>) {
+            auto u = static_cast<unsigned __int128>(obj);
+            if constexpr (std::is_same_v<T, __int128>)
+                u ^= static_cast<unsigned __int128>(1) << 127;
+            return reinterpret_cast<uint8_t*>(&u)[index];
+        }
+        else
+#endif
         if constexpr (std::is_unsigned_v<T>) {
             // Unsigned integer: direct byte access
             return reinterpret_cast<const uint8_t*>(&obj)[index];
@@ -49,6 +88,11 @@ struct radix_trait
 
             return reinterpret_cast<uint8_t*>(&u2)[index];
         }
+        else if constexpr (std::is_enum_v<T>) {
+            // Enumeration: order of the underlying integer
+            using Underlying = std::underlying_type_t<T>;
+            return radix_trait<Underlying>::template get<index>(static_cast<Underlying>(obj));
+        }
         else if constexpr (std::is_pointer_v<T>) {
             // Pointer: treat as unsigned integer
             using UInt = std::uintptr_t;
@@ -57,7 +101,7 @@ struct radix_trait
         }
         else {
             static_assert(sizeof(T) == 0, 
-                "radix_trait only supports unsigned integers, floating point, and pointers");
+                "radix_trait only supports integers, enumerations, floating point, pointers, pairs, tuples and arrays");
 			return 0;
         }
     }
@@ -94,10 +138,277 @@ struct radix_trait<std::pair<p1, p2>>
 	}
 };
 
+//Width of a digit in bits, a trait may set radix_bits for digits other than bytes
+template <typename Trait>
+constexpr std::size_t radix_bits_v = [] {
+	if constexpr (requires { Trait::radix_bits; })
+		return std::size_t(Trait::radix_bits);
+	else
+		return std::size_t(8);
+}();
+
+//Number of buckets of a digit
+template <typename Trait>
+constexpr std::size_t radix_count_v = std::size_t(1) << radix_bits_v<Trait>;
+
+template <typename Trait, typename cnt_type>
+using radix_counter = std::array<cnt_type, radix_count_v<Trait>>;
+
+// ----------------------------------------------
+// radix_trait_bits: digits of Bits bits built from the digits of Trait,
+// e.g. radix_trait_bits<11, radix_trait<uint32_t>> sorts in 3 passes instead of 4
+// ----------------------------------------------
+template <std::size_t Bits, typename Trait>
+struct radix_trait_bits
+{
+	static_assert(Bits >= 1 && Bits <= 16, "digits are limited to 16 bits");
+	static constexpr std::size_t radix_bits = Bits;
+	static constexpr std::size_t key_bits = Trait::radix_size * radix_bits_v<Trait>;
+	static constexpr std::size_t radix_size = (key_bits + Bits - 1) / Bits;
+
+	template <size_t index, typename T>
+	static uint16_t get(const T& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		constexpr std::size_t base_bits = radix_bits_v<Trait>, low = index * Bits;
+		constexpr std::size_t high = std::min(low + Bits, key_bits), first = low / base_bits;
+		return [&]<size_t... k>(std::index_sequence<k...>) {
+			uint32_t digit = 0;
+			((digit |= part<first + k, low>(obj)), ...);
+			return static_cast<uint16_t>(digit & ((uint32_t(1) << Bits) - 1));
+		}(std::make_index_sequence<(high - 1) / base_bits - first + 1>());
+	}
+
+private:
+	//digit d of Trait moved to its position inside the digit starting at bit low
+	template <size_t d, size_t low, typename T>
+	static uint32_t part(const T& obj) noexcept
+	{
+		constexpr std::size_t pos = d * radix_bits_v<Trait>;
+		uint32_t value = Trait::template get<d>(obj);
+		if constexpr (pos >= low)
+			return value << (pos - low);
+		else
+			return value >> (low - pos);
+	}
+};
+
+// ----------------------------------------------
+// radix_trait_low: the n least significant digits of Trait
+// ----------------------------------------------
+template <typename Trait, std::size_t n>
+struct radix_trait_low
+{
+	static constexpr std::size_t radix_bits = radix_bits_v<Trait>;
+	static constexpr std::size_t radix_size = n;
+
+	template <size_t index, typename T>
+	static auto get(const T& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		return Trait::template get<index>(obj);
+	}
+};
+
+// ----------------------------------------------
+// radix_trait_reverse: the order of Trait reversed, for any trait (radix_trait_greater only wraps radix_trait<T>)
+// ----------------------------------------------
+template <typename Trait>
+struct radix_trait_reverse
+{
+	static constexpr std::size_t radix_bits = radix_bits_v<Trait>;
+	static constexpr std::size_t radix_size = Trait::radix_size;
+
+	template <size_t index, typename T>
+	static auto get(const T& obj) noexcept
+	{
+		auto digit = Trait::template get<index>(obj);
+		return static_cast<decltype(digit)>(radix_count_v<Trait> - 1 - digit);
+	}
+};
+
+// ----------------------------------------------
+// Composite keys: tuples and arrays compare from their first element, like their operator<
+// ----------------------------------------------
+//Digits of a tuple of keys, each under its own trait, the first key the most significant
+template <typename... Traits>
+struct radix_trait_columns
+{
+	using first_trait = std::tuple_element_t<0, std::tuple<Traits...>>;
+	static_assert(((radix_bits_v<Traits> == radix_bits_v<first_trait>) && ...), "key columns need digits of the same width");
+	static constexpr std::size_t radix_bits = radix_bits_v<first_trait>;
+	static constexpr std::size_t radix_size = (Traits::radix_size + ...);
+
+	template <size_t index, typename Tuple>
+	static auto get(const Tuple& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		return digit<sizeof...(Traits) - 1, index>(obj);
+	}
+
+private:
+	template <size_t c, size_t index, typename Tuple>
+	static auto digit(const Tuple& obj) noexcept
+	{
+		using Trait = std::tuple_element_t<c, std::tuple<Traits...>>;
+		if constexpr (index < Trait::radix_size)
+			return Trait::template get<index>(std::get<c>(obj));
+		else
+			return digit<c - 1, index - Trait::radix_size>(obj);
+	}
+};
+
+template <typename... Ts>
+struct radix_trait<std::tuple<Ts...>> : radix_trait_columns<radix_trait<Ts>...>
+{
+};
+
+template <typename T, std::size_t N>
+struct radix_trait<std::array<T, N>>
+{
+	static constexpr std::size_t radix_size = N * radix_trait<T>::radix_size;
+	template <size_t index>
+	static uint8_t get(const std::array<T, N>& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		constexpr std::size_t size = radix_trait<T>::radix_size;
+		return radix_trait<T>::template get<index % size>(obj[N - 1 - index / size]);
+	}
+};
+
+// ----------------------------------------------
+// radix_trait_fields: trait of T built from some of its fields, the first field the most significant. A field keeps
+// Bytes digits of its radix_trait from digit Low up, so the bytes that never vary (the high bytes of a timestamp,
+// the zero top of an id) cost no pass, e.g.
+// radix_trait_fields<event, radix_field<&event::tenant>, radix_field<&event::time, radix_order::descending, 5>>
+// ----------------------------------------------
+enum class radix_order
+{
+	ascending,
+	descending
+};
+
+//A field of radix_trait_fields: a data member pointer, or an index for std::get
+template <auto Field, radix_order Order = radix_order::ascending, std::size_t Bytes = std::size_t(-1), std::size_t Low = 0>
+struct radix_field
+{
+};
+
+template <typename T, typename Field>
+struct radix_field_trait;
+
+template <typename T, auto Field, radix_order Order, std::size_t Bytes, std::size_t Low>
+struct radix_field_trait<T, radix_field<Field, Order, Bytes, Low>>
+{
+	static const auto& project(const T& obj) noexcept
+	{
+		if constexpr (std::is_member_object_pointer_v<decltype(Field)>)
+			return obj.*Field;
+		else
+			return std::get<Field>(obj);
+	}
+
+	using value_type = std::remove_cvref_t<decltype(project(std::declval<const T&>()))>;
+	using trait = std::conditional_t<Order == radix_order::ascending, radix_trait<value_type>, radix_trait_reverse<radix_trait<value_type>>>;
+	static_assert(radix_bits_v<trait> == 8, "fields are made of bytes");
+	static constexpr std::size_t radix_size = Bytes == std::size_t(-1) ? trait::radix_size - Low : Bytes;
+	static_assert(Low + radix_size <= trait::radix_size, "the significant bytes of a field lie within it");
+
+	template <size_t index>
+	static uint8_t get(const T& obj) noexcept
+	{
+		return trait::template get<Low + index>(project(obj));
+	}
+};
+
+template <typename T, typename... Fields>
+struct radix_trait_fields
+{
+	static constexpr std::size_t radix_size = (radix_field_trait<T, Fields>::radix_size + ...);
+
+	template <size_t index>
+	static uint8_t get(const T& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		return digit<sizeof...(Fields) - 1, index>(obj);
+	}
+
+private:
+	template <size_t f, size_t index>
+	static uint8_t digit(const T& obj) noexcept
+	{
+		using Field = radix_field_trait<T, std::tuple_element_t<f, std::tuple<Fields...>>>;
+		if constexpr (index < Field::radix_size)
+			return Field::template get<index>(obj);
+		else
+			return digit<f - 1, index - Field::radix_size>(obj);
+	}
+};
+
+template <typename T>
+using radix_key_bits = std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>;
+
+//Unsigned integer of the same order as an IEEE754 key: negative keys flip every bit and the others flip the sign bit
+template <typename T>
+radix_key_bits<T> radix_float_key(T x) noexcept
+{
+	using UInt = radix_key_bits<T>;
+	using SInt = std::make_signed_t<UInt>;
+	auto u = std::bit_cast<UInt>(x);
+	return u ^ (static_cast<UInt>(static_cast<SInt>(u) >> (sizeof(UInt) * 8 - 1)) | (UInt(1) << (sizeof(UInt) * 8 - 1)));
+}
+
+//Keys whose order under Trait is one compare: integers, and IEEE754 floats through radix_float_key
+template <typename Trait, typename T>
+constexpr bool radix_one_compare = std::is_same_v<Trait, radix_trait<T>> && (std::is_integral_v<T> ||
+	(std::is_floating_point_v<T> && std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8)));
+
+//Order of two elements under Trait, comparing the digits below i from the most significant one
+template <typename Trait, size_t i = Trait::radix_size, typename T>
+bool radix_less(const T& a, const T& b) noexcept
+{
+	if constexpr (i == 0)
+		return false;
+	else if constexpr (i == Trait::radix_size && radix_one_compare<Trait, T>)
+	{
+		//same order, one compare
+		if constexpr (std::is_integral_v<T>)
+			return a < b;
+		else
+			return radix_float_key(a) < radix_float_key(b);
+	}
+	else
+	{
+		auto x = Trait::template get<i - 1>(a), y = Trait::template get<i - 1>(b);
+		if (x != y)
+			return x < y;
+		return radix_less<Trait, i - 1>(a, b);
+	}
+}
+
+//Stable insertion sort on the digits below i, for ranges too short to be worth counting
+template <typename Trait, size_t i = Trait::radix_size, typename Iter>
+void radix_insertion_sort(Iter first, Iter second)
+{
+	if (first == second)
+		return;
+	for (auto cur = std::next(first); cur != second; ++cur)
+	{
+		if (!radix_less<Trait, i>(*cur, *std::prev(cur)))
+			continue;
+		auto obj = std::move(*cur);
+		auto pos = cur;
+		do
+		{
+			*pos = std::move(*std::prev(pos));
+			--pos;
+		} while (pos != first && radix_less<Trait, i>(obj, *std::prev(pos)));
+		*pos = std::move(obj);
+	}
+}
+
 template<size_t i, typename Trait, typename Iter, typename cnt_type>
-void count_duff_device(
-	Iter begin, Iter end, std::array<cnt_type, 
-	std::numeric_limits<uint8_t>::max() + 1 >& counter)
+void count_duff_device(Iter begin, Iter end, radix_counter<Trait, cnt_type>& counter)
 {
 	if constexpr (i > 0)
 		memset(counter.data(), 0, sizeof(counter));
@@ -122,242 +433,3201 @@ void count_duff_device(
 	};
 }
 
-template<size_t i, typename Trait, typename Iter, typename cnt_type>
-void place_duff_device(Iter raw, typename std::iterator_traits<Iter>::value_type* buffer, 
-	std::array<cnt_type, std::numeric_limits<uint8_t>::max() + 1 >& counter, size_t pos_beg, size_t pos_end)
+template<typename Trait, typename cnt_type>
+using radix_histogram = std::array<radix_counter<Trait, cnt_type>, Trait::radix_size>;
+
+template<typename Trait, typename T, typename cnt_type, size_t... i>
+inline void count_digits(const T& obj, radix_histogram<Trait, cnt_type>& counter, std::index_sequence<i...>) noexcept
 {
-	if constexpr (i % 2 == 0)
-		raw += pos_beg;
-	else
-		buffer += pos_beg;
-	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
-	uint8_t t0, t1, t2, t3;
-	if constexpr (i % 2 == 0)
+	(++counter[i][Trait::template get<i>(obj)], ...);
+}
+
+//Count every digit in one streaming pass, so the input is read once for all the histograms
+template<typename Trait, typename Iter, typename cnt_type>
+void count_all_duff_device(Iter begin, Iter end, radix_histogram<Trait, cnt_type>& counter)
+{
+	constexpr auto digits = std::make_index_sequence<Trait::radix_size>();
+	memset(counter.data(), 0, sizeof(counter));
+	auto length = std::distance(begin, end);
+	if (length == 0)
+		return;
+	auto diff = (length % 4 + 3) % 4;
+	begin += diff;
+	end -= 1;
+	switch (diff)
 	{
-		switch (j_raw % 4)
+		for (;; begin += 4)
 		{
-			for (; j >= 0; j -= 4)
-			{
-				t3 = Trait::template get<i>(raw[j + 3]);
-				buffer[--counter[t3]] = std::move(raw[j + 3]);
-		[[fallthrough]]; case 3:	t2 = Trait::template get<i>(raw[j + 2]);
-			buffer[--counter[t2]] = std::move(raw[j + 2]);
-		[[fallthrough]]; case 2:	t1 = Trait::template get<i>(raw[j + 1]);
-			buffer[--counter[t1]] = std::move(raw[j + 1]);
-		[[fallthrough]]; case 1:	t0 = Trait::template get<i>(raw[j]);
-			buffer[--counter[t0]] = std::move(raw[j]);
-		[[fallthrough]]; case 0:;
-			}
+	[[fallthrough]]; case 3:count_digits<Trait>(*(begin - 3), counter, digits);
+	[[fallthrough]]; case 2:count_digits<Trait>(*(begin - 2), counter, digits);
+	[[fallthrough]]; case 1:count_digits<Trait>(*(begin - 1), counter, digits);
+	[[fallthrough]]; case 0:count_digits<Trait>(*begin, counter, digits);
+							if (begin == end) [[unlikely]]
+								break;
 		}
-	}
-	else
+	};
+}
+
+template<size_t i, typename Trait, typename SrcIter, typename DstIter, typename cnt_type>
+void place_duff_device(SrcIter src, DstIter dst, 
+	radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end)
+{
+	src += pos_beg;
+	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
+	size_t t0, t1, t2, t3;
+	switch (j_raw % 4)
 	{
-		switch (j_raw % 4)
+		for (; j >= 0; j -= 4)
 		{
-			for (; j >= 0; j -= 4)
-			{
-				t3 = Trait::template get<i>(buffer[j + 3]);
-				raw[--counter[t3]] = std::move(buffer[j + 3]);
-		[[fallthrough]]; case 3:	t2 = Trait::template get<i>(buffer[j + 2]);
-			raw[--counter[t2]] = std::move(buffer[j + 2]);
-		[[fallthrough]]; case 2:	t1 = Trait::template get<i>(buffer[j + 1]);
-			raw[--counter[t1]] = std::move(buffer[j + 1]);
-		[[fallthrough]]; case 1:	t0 = Trait::template get<i>(buffer[j]);
-			raw[--counter[t0]] = std::move(buffer[j]);
-		[[fallthrough]]; case 0:;
-			}
+			t3 = Trait::template get<i>(src[j + 3]);
+			dst[--counter[t3]] = std::move(src[j + 3]);
+	[[fallthrough]]; case 3:	t2 = Trait::template get<i>(src[j + 2]);
+		dst[--counter[t2]] = std::move(src[j + 2]);
+	[[fallthrough]]; case 2:	t1 = Trait::template get<i>(src[j + 1]);
+		dst[--counter[t1]] = std::move(src[j + 1]);
+	[[fallthrough]]; case 1:	t0 = Trait::template get<i>(src[j]);
+		dst[--counter[t0]] = std::move(src[j]);
+	[[fallthrough]]; case 0:;
 		}
 	}
 }
 
-template <size_t i, typename Trait, typename Iter, typename cnt_type>
-void radix_sort_impl(Iter first, Iter second, 
-	typename std::iterator_traits<Iter>::value_type* buffer, 
-	std::array<cnt_type, std::numeric_limits<uint8_t>::max() + 1 >& counter)
+//Counting the next digit while placing keeps a counter per slice in every thread, which only pays off for narrow digits
+template <typename Trait>
+constexpr bool radix_fusable(unsigned int thrd_lim) noexcept
 {
-	using namespace std;
-	constexpr auto radix_size = Trait::radix_size;
-
-	if constexpr (i < radix_size)
-	{
-		count_duff_device<i, Trait>(first, second, counter);
-		for (size_t j = 1; j <= numeric_limits<uint8_t>::max(); ++j)
-			counter[j] += counter[j - 1];
-		place_duff_device<i, Trait>(first, buffer, counter, 0, distance(first, second));
-	}
-	if constexpr (i != radix_size - 1)
-	{
-		radix_sort_impl<i + 1, Trait, Iter>(first, second, buffer, counter);
-	}
-	else if constexpr (radix_size % 2)
-	{
-		std::move(buffer, buffer + std::distance(first, second), first);
-	}
+	return radix_count_v<Trait> <= 2048 && thrd_lim * radix_count_v<Trait> <= 65536;
 }
 
-template <size_t i, typename Iter, typename Trait, typename cnt_type>
-void parallel_radix_sort_impl(Iter first, Iter second, unsigned int thrd_lim, typename std::iterator_traits<Iter>::value_type* buffer, std::array<cnt_type, std::numeric_limits<uint8_t>::max() + 1 >* counter)
+//Counts digit i + 1 of every placed element for the slice it lands in.
+//next_counter holds one counter per slice, so the next pass gets its per-thread counters without rereading the data.
+template<size_t i, typename Trait, typename cnt_type>
+class radix_slice_tally
 {
-	using namespace std;
-	constexpr auto radix_size = Trait::radix_size;
-	auto length = distance(first, second), parallel_width = length / thrd_lim;
-	if constexpr (i < radix_size)
+public:
+	radix_slice_tally(const radix_counter<Trait, cnt_type>& counter, radix_counter<Trait, cnt_type>* next_counter, 
+		size_t width, unsigned int thrd_lim) noexcept : width(width)
 	{
+		memset(next_counter, 0, sizeof(*next_counter) * thrd_lim);
+		//each bucket is filled backward, so its slice only changes when it crosses the lower boundary
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
 		{
-			vector<future<void>> wait_works;
-			wait_works.reserve(thrd_lim - 1);
-			auto j = 0u;
-			for (; j < thrd_lim - 1; ++j)
-			{
-				auto beg = j * parallel_width, end = beg + parallel_width;
-				if constexpr (i % 2 == 0)
-					wait_works.emplace_back(async(launch::async, count_duff_device<i, Trait, Iter, cnt_type>, 
-						first + beg, first + end, std::ref(counter[j])));
-				else
-					wait_works.emplace_back(async(launch::async, 
-						count_duff_device<i, Trait, typename std::iterator_traits<Iter>::value_type*, cnt_type>, buffer + beg, buffer + end, std::ref(counter[j])));
-			}
-			auto beg = j * parallel_width;
-			if constexpr (i % 2 == 0)
-				count_duff_device<i, Trait>(first + beg, first + length, counter[j]);
-			else
-				count_duff_device<i, Trait>(buffer + beg, buffer + length, counter[j]);
+			size_t slice = counter[k] == 0 ? 0 : std::min<size_t>((counter[k] - 1) / width, thrd_lim - 1);
+			owner[k] = next_counter + slice;
+			boundary[k] = slice * width;
 		}
+	}
 
-		for (int j = thrd_lim - 2; j >= 0; --j)
-			for (size_t k = 0; k <= numeric_limits<uint8_t>::max(); ++k)
-				counter[j][k] += counter[j + 1][k];
-		for (size_t j = 1; j <= numeric_limits<uint8_t>::max(); ++j)
-			counter[0][j] += counter[0][j - 1];
-		for (auto j = 1u; j < thrd_lim; ++j)
-			for (size_t k = 0; k <= numeric_limits<uint8_t>::max(); ++k)
-				counter[j][k] = counter[0][k] - counter[j][k];
-
-		vector<future<void>> wait_works;
-		wait_works.reserve(thrd_lim - 1);
-		auto j = 0u;
-		for (; j < thrd_lim - 1; ++j)
+	template <typename T>
+	void operator()(const T& obj, size_t t, size_t pos) noexcept
+	{
+		if (pos < boundary[t]) [[unlikely]]
 		{
-			auto beg = j * parallel_width, end = beg + parallel_width;
-			wait_works.emplace_back(async(launch::async, place_duff_device<i, Trait, Iter, cnt_type>, 
-				first, buffer, ref(counter[j + 1]), beg, end));
+			--owner[t];
+			boundary[t] -= width;
 		}
-		place_duff_device<i, Trait>(first, buffer, counter[0], j * parallel_width, length);
+		++(*owner[t])[Trait::template get<i + 1>(obj)];
 	}
-	if constexpr (i != radix_size - 1)
+
+private:
+	radix_counter<Trait, cnt_type>* owner[radix_count_v<Trait>];
+	size_t boundary[radix_count_v<Trait>];
+	size_t width;
+};
+
+//Place digit i and count the next digit with tally
+template<size_t i, typename Trait, typename SrcIter, typename DstIter, typename cnt_type, typename Tally>
+void place_count_duff_device(SrcIter src, DstIter dst, 
+	radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, Tally& tally)
+{
+	auto place = [&](auto& obj)
 	{
-		parallel_radix_sort_impl<i + 1, Iter, Trait>(first, second, thrd_lim, buffer, counter);
-	}
-	else if constexpr (radix_size % 2)
+		size_t t = Trait::template get<i>(obj);
+		size_t pos = --counter[t];
+		tally(obj, t, pos);
+		dst[pos] = std::move(obj);
+	};
+	src += pos_beg;
+	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
+	switch (j_raw % 4)
 	{
-		std::move(buffer, buffer + length, first);
+		for (; j >= 0; j -= 4)
+		{
+			place(src[j + 3]);
+	[[fallthrough]]; case 3:	place(src[j + 2]);
+	[[fallthrough]]; case 2:	place(src[j + 1]);
+	[[fallthrough]]; case 1:	place(src[j]);
+	[[fallthrough]]; case 0:;
+		}
 	}
 }
 
-template <typename Trait, typename Iter>
-void parallel_radix_sort(Iter first, Iter second, 
-	typename std::iterator_traits<Iter>::value_type* buffer = nullptr,
-	unsigned int thrd_lim = std::thread::hardware_concurrency())
+struct radix_no_tally
 {
-	using namespace std;
-	using value_type = typename iterator_traits<Iter>::value_type;
-	constexpr auto thrd_sort_length_limit = 100000; //each thread's min sort length
-	auto length = distance(first, second);
-	thrd_lim = min<decltype(length)>(thrd_lim, max<decltype(length)>(1u, length / thrd_sort_length_limit));
-	unique_ptr<uint8_t[]> resource;
-	if (buffer == nullptr)
-	{
-		resource = make_unique<uint8_t[]>(length * sizeof(value_type));
-		buffer = (value_type*)resource.get();
-	}
-	if (thrd_lim > 1)
-	{
-		//cnt type optimize seems negative in multi-thread?
-		auto counter = make_unique<array<decltype(length), numeric_limits<uint8_t>::max() + 1 >[]>(thrd_lim);
-		parallel_radix_sort_impl<0, Iter, Trait>(first, second, thrd_lim, buffer, counter.get());
+	template <typename T>
+	void operator()(const T&, size_t, size_t) const noexcept {}
+};
 
-	}
-	else
+//How the elements of a pass are stored into their buckets
+enum class radix_scatter
+{
+	automatic,		//stream whole lines once the data outgrows the caches
+	direct,			//store every element straight into its bucket
+	write_combine,	//gather a cache line per bucket and store whole lines
+	streaming		//as write_combine, with non-temporal stores of the whole lines
+};
+
+//Elements that may be copied as raw bytes
+template <typename T>
+struct radix_relocatable : std::is_trivially_copyable<T> {};
+
+template <typename p1, typename p2>
+struct radix_relocatable<std::pair<p1, p2>> : std::bool_constant<radix_relocatable<p1>::value && radix_relocatable<p2>::value> {};
+
+constexpr std::size_t radix_line_size = 64;
+
+//Write combining needs raw byte copies into contiguous storage, with several elements to a cache line
+template <typename Trait, typename SrcIter, typename DstIter>
+constexpr bool radix_combinable = [] {
+	using T = typename std::iterator_traits<SrcIter>::value_type;
+	return std::contiguous_iterator<SrcIter> && std::contiguous_iterator<DstIter> && radix_relocatable<T>::value &&
+		sizeof(T) * 2 <= radix_line_size && (sizeof(T) & (sizeof(T) - 1)) == 0 && radix_count_v<Trait> <= 256;
+}();
+
+inline void radix_store_line(void* dst, const void* line, bool stream) noexcept
+{
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	if (stream)
 	{
-		if (length <= INT_MAX) //int is enough for counter
-		{
-			auto counter = make_unique<array<int, numeric_limits<uint8_t>::max() + 1 >>();
-			radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
-		}
-		else
-		{
-			auto counter = make_unique<array<decltype(length), numeric_limits<uint8_t>::max() + 1 >>();
-			radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
-		}
+		auto d = static_cast<__m128i*>(dst);
+		auto s = static_cast<const __m128i*>(line);
+		for (size_t k = 0; k < radix_line_size / sizeof(__m128i); ++k)
+			_mm_stream_si128(d + k, _mm_load_si128(s + k));
+		return;
 	}
+#endif
+	(void)stream;
+	memcpy(dst, line, radix_line_size);
 }
 
-template <typename Iter>
-void parallel_radix_sort(Iter first, Iter second, 
-	typename std::iterator_traits<Iter>::value_type* buffer = nullptr, 
-	unsigned int thrd_lim = std::thread::hardware_concurrency())
+//Non-temporal stores must be visible before another thread reads the destination
+inline void radix_stream_fence() noexcept
 {
-	parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer, thrd_lim);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	_mm_sfence();
+#endif
 }
 
+// ----------------------------------------------
+// Key encoding: floating point keys are sorted as unsigned integers of the same order. The keys are encoded in
+// place before the passes and decoded after them, instead of every digit of every pass paying the transform.
+// ----------------------------------------------
+//Ranges sorted through their encoding: contiguous IEEE754 keys under the default trait
 template <typename Trait, typename Iter>
-void radix_sort(Iter first, Iter second, 
-	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+constexpr bool radix_encodable = [] {
+	using T = typename std::iterator_traits<Iter>::value_type;
+	return std::is_same_v<Trait, radix_trait<T>> && std::contiguous_iterator<Iter> && std::is_floating_point_v<T> && 
+		std::numeric_limits<T>::is_iec559 && (sizeof(T) == 4 || sizeof(T) == 8);
+}();
+
+//The two extra passes over the data only pay off once it outgrows the caches
+constexpr std::size_t radix_encode_bytes = std::size_t(16) << 20;
+
+//Digits of keys that radix_encode left in place, read byte by byte like the unsigned integers of radix_trait. The sort moves
+//them as T, so the storage is only ever accessed as T or as bytes and no other type aliases it.
+template <typename T>
+struct radix_trait_encoded
 {
-	using namespace std;
-	using value_type = typename iterator_traits<Iter>::value_type;
-	auto length = distance(first, second);
-	unique_ptr<uint8_t[]> resource;
-	if (buffer == nullptr)
+	static constexpr size_t radix_size = sizeof(T);
+
+	template <size_t index>
+	static uint8_t get(const T& obj) noexcept
 	{
-		resource = make_unique<uint8_t[]>(length * sizeof(value_type));
-		buffer = (value_type*)resource.get();
+		return reinterpret_cast<const uint8_t*>(&obj)[index];
 	}
-	if (length <= INT_MAX) //int is enough for counter 
+};
+
+//Negative keys flip every bit and the others flip the sign bit, decoding undoes the same flips
+template <bool decode, typename T>
+void radix_encode_scalar(T* data, std::size_t length) noexcept
+{
+	using UInt = radix_key_bits<T>;
+	using SInt = std::make_signed_t<UInt>;
+	constexpr UInt SIGN = UInt(1) << (sizeof(UInt) * 8 - 1);
+	for (std::size_t k = 0; k < length; ++k)
 	{
-		auto counter = make_unique<array<int, numeric_limits<uint8_t>::max() + 1 >>();
-		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
+		UInt u;
+		memcpy(&u, data + k, sizeof(u));
+		UInt neg = static_cast<UInt>(static_cast<SInt>(u) >> (sizeof(UInt) * 8 - 1));
+		u ^= (decode ? ~neg : neg) | SIGN;
+		memcpy(data + k, &u, sizeof(u));
 	}
-	else
+}
+
+#ifdef RADIX_SORT_AVX2_DISPATCH
+template <bool decode, typename T>
+__attribute__((target("avx2"))) void radix_encode_avx2(T* data, std::size_t length) noexcept
+{
+	constexpr std::size_t step = sizeof(__m256i) / sizeof(T);
+	const __m256i sign = sizeof(T) == 4 ? _mm256_set1_epi32(INT32_MIN) : _mm256_set1_epi64x(INT64_MIN);
+	std::size_t k = 0;
+	for (; k + step <= length; k += step)
 	{
-		auto counter = make_unique<array<decltype(length), numeric_limits<uint8_t>::max() + 1 >>();
-		radix_sort_impl<0, Trait, Iter>(first, second, buffer, *counter);
+		auto ptr = reinterpret_cast<__m256i*>(data + k);
+		__m256i u = _mm256_loadu_si256(ptr), neg;
+		if constexpr (sizeof(T) == 4)
+			neg = _mm256_srai_epi32(u, 31);
+		else
+			neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), u);
+		if constexpr (decode)
+			neg = _mm256_xor_si256(neg, _mm256_set1_epi32(-1));
+		_mm256_storeu_si256(ptr, _mm256_xor_si256(u, _mm256_or_si256(neg, sign)));
 	}
+	radix_encode_scalar<decode>(data + k, length - k);
 }
 
-template <typename Iter>
-void radix_sort(Iter first, Iter second, 
-	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+inline bool radix_has_avx2() noexcept
 {
-	radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	return avx2;
 }
+#endif
 
-template <typename Iter, typename ExecutionPolicy>
-void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy,
-	 typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+//Encode or decode keys in place with the widest kernel the CPU runs
+template <bool decode, typename T>
+void radix_encode(T* data, std::size_t length) noexcept
 {
-	// 添加 (void)policy 来消除警告
-	(void)policy;
+#ifdef RADIX_SORT_AVX2_DISPATCH
+	if (radix_has_avx2())
+		return radix_encode_avx2<decode>(data, length);
+#endif
+	radix_encode_scalar<decode>(data, length);
+}
 
-	if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, \
-		std::execution::parallel_policy> || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, \
-		std::execution::parallel_unsequenced_policy>)
-		parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
-	else
-		radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+//Place digit i through a cache line per bucket. Elements gather in their bucket's line and go out as a whole line
+//once the bucket reaches a line boundary, so a pass stores to at most one line per bucket at a time instead of
+//scattering single elements across all buckets' pages.
+template<size_t i, typename Trait, typename T, typename cnt_type, typename Tally>
+void place_combine_duff_device(T* src, T* dst, 
+	radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, bool stream, Tally& tally)
+{
+	constexpr size_t radix_count = radix_count_v<Trait>, slots = radix_line_size / sizeof(T);
+	alignas(radix_line_size) unsigned char stage[radix_count][radix_line_size];
+	size_t top[radix_count]; //positions [counter[k], top[k]) are staged
+	for (size_t k = 0; k < radix_count; ++k)
+		top[k] = counter[k];
+	auto slot_of = [dst](size_t pos) {
+		return reinterpret_cast<std::uintptr_t>(dst + pos) % radix_line_size / sizeof(T);
+	};
+	auto place = [&](T& obj)
+	{
+		size_t t = Trait::template get<i>(obj);
+		size_t pos = --counter[t];
+		tally(obj, t, pos);
+		auto slot = slot_of(pos);
+		memcpy(stage[t] + slot * sizeof(T), static_cast<const void*>(&obj), sizeof(T));
+		if (slot == 0)
+		{
+			if (top[t] - pos == slots)
+				radix_store_line(dst + pos, stage[t], stream);
+			else
+				memcpy(static_cast<void*>(dst + pos), stage[t], (top[t] - pos) * sizeof(T));
+			top[t] = pos;
+		}
+	};
+	src += pos_beg;
+	std::ptrdiff_t j_raw = pos_end - pos_beg, j = j_raw - (j_raw % 4);
+	switch (j_raw % 4)
+	{
+		for (; j >= 0; j -= 4)
+		{
+			place(src[j + 3]);
+	[[fallthrough]]; case 3:	place(src[j + 2]);
+	[[fallthrough]]; case 2:	place(src[j + 1]);
+	[[fallthrough]]; case 1:	place(src[j]);
+	[[fallthrough]]; case 0:;
+		}
+	}
+	for (size_t k = 0; k < radix_count; ++k)
+		if (top[k] != size_t(counter[k]))
+			memcpy(static_cast<void*>(dst + counter[k]), stage[k] + slot_of(counter[k]) * sizeof(T), (top[k] - counter[k]) * sizeof(T));
+	if (stream)
+		radix_stream_fence();
 }
 
-template <typename Trait, typename Iter, typename ExecutionPolicy>
-void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, 
-	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+//Place digit i of [pos_beg, pos_end) through the chosen scatter path, counting the next digit with tally
+template<size_t i, typename Trait, typename SrcIter, typename DstIter, typename cnt_type, typename Tally = radix_no_tally>
+void place_pass(SrcIter src, DstIter dst, radix_counter<Trait, cnt_type>& counter, size_t pos_beg, size_t pos_end, 
+	radix_scatter scatter, Tally&& tally = {})
 {
-	// 添加 (void)policy 来消除警告
+	using T = typename std::iterator_traits<SrcIter>::value_type;
+	if constexpr (radix_combinable<Trait, SrcIter, DstIter>)
+		if (scatter != radix_scatter::direct && reinterpret_cast<std::uintptr_t>(std::to_address(dst)) % sizeof(T) == 0)
+			return place_combine_duff_device<i, Trait>(std::to_address(src), std::to_address(dst), counter, pos_beg, pos_end, 
+				scatter == radix_scatter::streaming, tally);
+	if constexpr (std::is_same_v<std::remove_cvref_t<Tally>, radix_no_tally>)
+		place_duff_device<i, Trait>(src, dst, counter, pos_beg, pos_end);
+	else
+		place_count_duff_device<i, Trait>(src, dst, counter, pos_beg, pos_end, tally);
+}
+
+//Scatter path for automatic: once the data no longer fits in the caches, whole lines are streamed past them
+template <typename T>
+radix_scatter resolve_scatter(radix_scatter scatter, std::ptrdiff_t length) noexcept
+{
+	if (scatter != radix_scatter::automatic)
+		return scatter;
+	return length * sizeof(T) >= (std::size_t(16) << 20) ? radix_scatter::streaming : radix_scatter::direct;
+}
+
+//A digit is trivial when every element falls into one bucket: its pass would leave the order unchanged
+template <size_t i, typename Trait, typename cnt_type>
+bool trivial_digit(std::ptrdiff_t length, const radix_histogram<Trait, cnt_type>* histogram, size_t histogram_cnt = 1)
+{
+	for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+	{
+		std::ptrdiff_t cnt = 0;
+		for (size_t j = 0; j < histogram_cnt; ++j)
+			cnt += histogram[j][i][k];
+		if (cnt != 0)
+			return cnt == length;
+	}
+	return true;
+}
+
+// ----------------------------------------------
+// Sort statistics: a Stats observer with enabled set receives begin(length, threads), allocate(bytes), count(ns),
+// pass(radix_pass_stats) and end(ns) from the sort. radix_no_stats compiles every hook and timer out.
+// ----------------------------------------------
+struct radix_no_stats
+{
+	static constexpr bool enabled = false;
+};
+
+template <typename Stats>
+concept radix_stats_observer = requires { { Stats::enabled } -> std::convertible_to<bool>; };
+
+//What one digit looked like and what its pass cost
+struct radix_pass_stats
+{
+	std::size_t digit = 0;
+	bool skipped = false;			//every element had the same digit, there was no pass
+	std::ptrdiff_t max_bucket = 0;
+	double entropy = 0;				//of the digit histogram in bits, radix_bits_v at most
+	double count_ns = 0;			//per-thread counters of the pass, parallel sorts only
+	double scatter_ns = 0;
+	std::size_t bytes_moved = 0;
+};
+
+//Collects the statistics of the last sort it was given to
+struct radix_sort_stats
+{
+	static constexpr bool enabled = true;
+
+	std::size_t length = 0;
+	unsigned int threads = 0;		//after clamping to the length
+	std::size_t allocated_bytes = 0;	//scratch allocated by the sort
+	double count_ns = 0;			//histograms of every digit, read in one pass
+	double total_ns = 0;
+	std::vector<radix_pass_stats> passes;
+
+	void begin(std::size_t n, unsigned int thrd_cnt)
+	{
+		length = n;
+		threads = thrd_cnt;
+		allocated_bytes = 0;
+		count_ns = total_ns = 0;
+		passes.clear();
+	}
+	void allocate(std::size_t bytes)
+	{
+		allocated_bytes += bytes;
+	}
+	void count(double ns)
+	{
+		count_ns += ns;
+	}
+	void pass(const radix_pass_stats& stats)
+	{
+		passes.push_back(stats);
+	}
+	void end(double ns)
+	{
+		total_ns = ns;
+	}
+};
+
+//Start of a timed phase, no clock is read unless Stats is enabled
+template <typename Stats>
+auto radix_stats_now() noexcept
+{
+	if constexpr (Stats::enabled)
+		return std::chrono::steady_clock::now();
+	else
+		return 0;
+}
+
+template <typename Stats, typename Time>
+double radix_stats_ns(Time beg) noexcept
+{
+	if constexpr (Stats::enabled)
+		return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - beg).count();
+	else
+		return 0;
+}
+
+//Largest bucket and entropy of digit i summed over histogram_cnt histograms
+template <size_t i, typename Trait, typename cnt_type>
+radix_pass_stats radix_digit_stats(std::ptrdiff_t length, const radix_histogram<Trait, cnt_type>* histogram, size_t histogram_cnt = 1)
+{
+	radix_pass_stats stats;
+	stats.digit = i;
+	for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+	{
+		std::ptrdiff_t cnt = 0;
+		for (size_t j = 0; j < histogram_cnt; ++j)
+			cnt += histogram[j][i][k];
+		stats.max_bucket = std::max(stats.max_bucket, cnt);
+		if (cnt != 0)
+			stats.entropy -= double(cnt) / double(length) * std::log2(double(cnt) / double(length));
+	}
+	return stats;
+}
+
+template <size_t i, typename Trait, typename Iter, typename cnt_type, typename Stats = radix_no_stats>
+void radix_sort_impl(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer, 
+	radix_histogram<Trait, cnt_type>& counter, radix_scatter scatter = radix_scatter::direct, bool in_buffer = false, 
+	Stats* stats = nullptr)
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	auto length = distance(first, second);
+
+	if constexpr (i == 0)
+	{
+		[[maybe_unused]] auto beg = radix_stats_now<Stats>();
+		count_all_duff_device<Trait>(first, second, counter);
+		if constexpr (Stats::enabled)
+			stats->count(radix_stats_ns<Stats>(beg));
+	}
+	if constexpr (i < radix_size)
+	{
+		[[maybe_unused]] auto beg = radix_stats_now<Stats>();
+		[[maybe_unused]] radix_pass_stats record;
+		if constexpr (Stats::enabled)
+			record = radix_digit_stats<i, Trait>(length, &counter);
+		bool skipped = trivial_digit<i, Trait>(length, &counter);
+		if (!skipped)
+		{
+			for (size_t j = 1; j < radix_count_v<Trait>; ++j)
+				counter[i][j] += counter[i][j - 1];
+			if (in_buffer)
+				place_pass<i, Trait>(buffer, first, counter[i], 0, length, scatter);
+			else
+				place_pass<i, Trait>(first, buffer, counter[i], 0, length, scatter);
+			in_buffer = !in_buffer;
+		}
+		if constexpr (Stats::enabled)
+		{
+			record.skipped = skipped;
+			record.scatter_ns = skipped ? 0 : radix_stats_ns<Stats>(beg);
+			record.bytes_moved = skipped ? 0 : length * sizeof(*buffer);
+			stats->pass(record);
+		}
+	}
+	if constexpr (i + 1 < radix_size)
+	{
+		radix_sort_impl<i + 1, Trait, Iter>(first, second, buffer, counter, scatter, in_buffer, stats);
+	}
+	else if (in_buffer)
+	{
+		std::move(buffer, buffer + length, first);
+	}
+}
+
+//Reusable barrier for the workers of one parallel sort
+class radix_barrier
+{
+public:
+	explicit radix_barrier(unsigned int thrd_cnt = 1) noexcept : expected(thrd_cnt) {}
+
+	void reset(unsigned int thrd_cnt) noexcept
+	{
+		expected = thrd_cnt;
+		arrived.store(0, std::memory_order_relaxed);
+	}
+
+	void arrive_and_wait() noexcept
+	{
+		auto cur = phase.load(std::memory_order_acquire);
+		if (arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == expected)
+		{
+			arrived.store(0, std::memory_order_relaxed);
+			phase.fetch_add(1, std::memory_order_release);
+			phase.notify_all();
+		}
+		else
+			phase.wait(cur, std::memory_order_acquire);
+	}
+
+private:
+	unsigned int expected;
+	std::atomic<unsigned int> arrived{ 0 };
+	std::atomic<unsigned int> phase{ 0 };
+};
+
+//Placement of the workers of a pool
+enum class radix_affinity
+{
+	none,	//workers float, the calling thread runs the last job
+	numa	//every job runs on a worker bound to its node, consecutive jobs share a node, scratch is placed by first touch
+};
+
+//Bind the calling thread to the node of worker id out of thrd_cnt, the workers fill the nodes in order.
+//Without libnuma (RADIX_SORT_NUMA) threads are left where the OS puts them.
+inline void radix_bind_node(unsigned int id, unsigned int thrd_cnt) noexcept
+{
+#ifdef RADIX_SORT_NUMA
+	if (numa_available() < 0)
+		return;
+	auto nodes = static_cast<unsigned int>(numa_num_configured_nodes());
+	numa_run_on_node(static_cast<int>(static_cast<uint64_t>(id) * nodes / thrd_cnt));
+#else
+	(void)id;
+	(void)thrd_cnt;
+#endif
+}
+
+//Write one byte to every page starting in [data, data + length), so that the pages of a fresh allocation land on
+//the node of the calling thread
+template <typename T>
+void radix_first_touch(T* data, std::size_t length) noexcept
+{
+	constexpr std::uintptr_t page = 4096;
+	auto beg = reinterpret_cast<std::uintptr_t>(data), end = beg + length * sizeof(T);
+	for (auto pos = (beg + page - 1) & ~(page - 1); pos < end; pos += page)
+		*reinterpret_cast<volatile char*>(pos) = 0;
+}
+
+//Persistent workers for parallel sorting, so that a sort does not start new threads on every pass
+class radix_thread_pool
+{
+public:
+	explicit radix_thread_pool(unsigned int thrd_cnt = std::thread::hardware_concurrency(), 
+		radix_affinity affinity = radix_affinity::none)
+		: affinity(affinity), spare(affinity == radix_affinity::numa ? 0 : 1)
+	{
+		thrd_cnt = std::max(thrd_cnt, 1u);
+		workers.reserve(thrd_cnt - spare);
+		for (auto j = 0u; j + spare < thrd_cnt; ++j)
+			workers.emplace_back(&radix_thread_pool::work, this, j, thrd_cnt);
+	}
+
+	~radix_thread_pool()
+	{
+		stopping = true;
+		generation.fetch_add(1, std::memory_order_release);
+		generation.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	radix_thread_pool(const radix_thread_pool&) = delete;
+	radix_thread_pool& operator=(const radix_thread_pool&) = delete;
+
+	//the calling thread is counted as one of the threads, unless the workers are bound to nodes
+	unsigned int size() const noexcept
+	{
+		return static_cast<unsigned int>(workers.size()) + spare;
+	}
+
+	bool numa_aware() const noexcept
+	{
+		return affinity == radix_affinity::numa;
+	}
+
+	//Run job(j) for every j in [0, thrd_lim), the calling thread runs job(thrd_lim - 1) unless the pool is NUMA aware.
+	//A pool that is busy (or too small) falls back to short-lived threads, so nested and concurrent calls are safe.
+	//run returns once every job has, and then rethrows the first exception of a job. A job that throws must not leave
+	//the others waiting for it.
+	template <typename Job>
+	void run(unsigned int thrd_lim, Job&& job)
+	{
+		std::unique_lock<std::mutex> lock(run_mtx, std::try_to_lock);
+		if (!lock.owns_lock() || thrd_lim > size())
+		{
+			//the futures of std::async wait for their job when destroyed
+			std::vector<std::future<void>> wait_works;
+			wait_works.reserve(thrd_lim - 1);
+			for (auto j = 0u; j + 1 < thrd_lim; ++j)
+				wait_works.emplace_back(std::async(std::launch::async, [&job, j]() { job(j); }));
+			job(thrd_lim - 1);
+			for (auto& work : wait_works)
+				work.get();
+			return;
+		}
+		task = [](void* ctx, unsigned int j) { (*static_cast<std::remove_reference_t<Job>*>(ctx))(j); };
+		task_ctx = &job;
+		active = thrd_lim - spare;
+		error = nullptr;	//left over when the job of the calling thread threw as well
+		//idle workers check in as well, so none of them still reads active or task once run returns
+		pending.store(static_cast<unsigned int>(workers.size()), std::memory_order_relaxed);
+		generation.fetch_add(1, std::memory_order_release);
+		generation.notify_all();
+		{
+			//the workers still call job when the job of the calling thread throws
+			struct pending_guard
+			{
+				radix_thread_pool* pool;
+				~pending_guard() { pool->wait_pending(); }
+			} guard{ this };
+			if (spare != 0)
+				job(thrd_lim - 1);
+		}
+		if (error)
+			std::rethrow_exception(std::exchange(error, nullptr));
+	}
+
+	//Shared by the sorts that are not given a pool
+	static radix_thread_pool& default_pool()
+	{
+		static radix_thread_pool pool;
+		return pool;
+	}
+
+private:
+	void wait_pending() noexcept
+	{
+		for (auto left = pending.load(std::memory_order_acquire); left != 0; left = pending.load(std::memory_order_acquire))
+			pending.wait(left, std::memory_order_acquire);
+	}
+
+	void work(unsigned int id, unsigned int thrd_cnt)
+	{
+		if (affinity == radix_affinity::numa)
+			radix_bind_node(id, thrd_cnt);
+		unsigned int seen = 0;
+		for (;;)
+		{
+			generation.wait(seen, std::memory_order_acquire);
+			seen = generation.load(std::memory_order_acquire);
+			if (stopping)
+				return;
+			if (id < active)
+			{
+				try
+				{
+					task(task_ctx, id);
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(error_mtx);
+					if (!error)
+						error = std::current_exception();
+				}
+			}
+			if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+				pending.notify_one();
+		}
+	}
+
+	radix_affinity affinity;
+	unsigned int spare;		//jobs run by the calling thread
+	std::vector<std::thread> workers;
+	std::mutex run_mtx;
+	void (*task)(void*, unsigned int) = nullptr;
+	void* task_ctx = nullptr;
+	unsigned int active = 0;
+	std::mutex error_mtx;
+	std::exception_ptr error;	//first exception of a worker job in this run
+	std::atomic<unsigned int> pending{ 0 };
+	std::atomic<unsigned int> generation{ 0 };
+	std::atomic<bool> stopping{ false };
+};
+
+//Where the per-thread counters of the next executed pass come from
+enum class radix_counter_state
+{
+	histogram,	//nothing has moved yet, the histograms of the first pass are still valid
+	fused,		//the previous pass counted this digit while placing
+	stale		//the previous pass was not fused, count again
+};
+
+//Shared by the threads of one parallel sort
+template <typename Iter, typename Trait, typename cnt_type, typename Stats = radix_no_stats>
+struct parallel_radix_context
+{
+	Iter first;
+	typename std::iterator_traits<Iter>::value_type* buffer;
+	std::ptrdiff_t length, parallel_width;
+	unsigned int thrd_lim;
+	radix_histogram<Trait, cnt_type>* histogram;
+	radix_counter<Trait, cnt_type>* counter;
+	radix_counter<Trait, cnt_type>* next_counter;
+	radix_scatter scatter;
+	radix_barrier* sync;
+	Stats* stats;	//filled by thread 0
+};
+
+//The part of a parallel sort run by thread j, threads meet at the barrier between the phases of every pass
+template <size_t i, typename Iter, typename Trait, typename cnt_type, typename Stats>
+void parallel_radix_sort_impl(const parallel_radix_context<Iter, Trait, cnt_type, Stats>& ctx, unsigned int j,
+	bool in_buffer = false, radix_counter_state state = radix_counter_state::histogram)
+{
+	using namespace std;
+	constexpr auto radix_size = Trait::radix_size;
+	auto [first, buffer, length, parallel_width, thrd_lim, histogram, counter, next_counter, scatter, sync, stats] = ctx;
+	size_t beg = j * parallel_width, end = j + 1 == thrd_lim ? length : beg + parallel_width;
+	[[maybe_unused]] auto phase = radix_stats_now<Stats>();
+
+	if constexpr (i == 0)
+	{
+		count_all_duff_device<Trait>(first + beg, first + end, histogram[j]);
+		sync->arrive_and_wait();
+		if constexpr (Stats::enabled)
+			if (j == 0)
+			{
+				stats->count(radix_stats_ns<Stats>(phase));
+				phase = radix_stats_now<Stats>();
+			}
+	}
+	if constexpr (i < radix_size)
+	{
+		[[maybe_unused]] radix_pass_stats record;
+		if constexpr (Stats::enabled)
+			if (j == 0)
+				record = radix_digit_stats<i, Trait>(length, histogram, thrd_lim);
+		if (trivial_digit<i, Trait>(length, histogram, thrd_lim))
+		{
+			if constexpr (Stats::enabled)
+				if (j == 0)
+				{
+					record.skipped = true;
+					stats->pass(record);
+				}
+		}
+		else
+		{
+			if (state == radix_counter_state::histogram)
+				counter[j] = histogram[j][i];
+			else if (state == radix_counter_state::fused)
+			{
+				//the previous pass counted this digit per destination slice
+				counter[j] = next_counter[j];
+				for (auto src = 1u; src < thrd_lim; ++src)
+					for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+						counter[j][k] += next_counter[src * thrd_lim + j][k];
+			}
+			else if (in_buffer)
+				count_duff_device<i, Trait>(buffer + beg, buffer + end, counter[j]);
+			else
+				count_duff_device<i, Trait>(first + beg, first + end, counter[j]);
+			sync->arrive_and_wait();
+
+			if (j == 0)
+			{
+				for (int t = thrd_lim - 2; t >= 0; --t)
+					for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+						counter[t][k] += counter[t + 1][k];
+				for (size_t k = 1; k < radix_count_v<Trait>; ++k)
+					counter[0][k] += counter[0][k - 1];
+				for (auto t = 1u; t < thrd_lim; ++t)
+					for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+						counter[t][k] = counter[0][k] - counter[t][k];
+			}
+			sync->arrive_and_wait();
+			if constexpr (Stats::enabled)
+				if (j == 0)
+				{
+					record.count_ns = radix_stats_ns<Stats>(phase);
+					phase = radix_stats_now<Stats>();
+				}
+
+			bool fuse = false;
+			if constexpr (i + 1 < radix_size && radix_fusable<Trait>(1))
+				fuse = radix_fusable<Trait>(thrd_lim) && !trivial_digit<i + 1, Trait>(length, histogram, thrd_lim);
+			auto place = [&](auto src, auto dst)
+			{
+				if constexpr (i + 1 < radix_size && radix_fusable<Trait>(1))
+					if (fuse)
+						return place_pass<i, Trait>(src, dst, counter[(j + 1) % thrd_lim], beg, end, scatter,
+							radix_slice_tally<i, Trait, cnt_type>(counter[(j + 1) % thrd_lim], next_counter + j * thrd_lim, parallel_width, thrd_lim));
+				place_pass<i, Trait>(src, dst, counter[(j + 1) % thrd_lim], beg, end, scatter);
+			};
+			if (in_buffer)
+				place(buffer, first);
+			else
+				place(first, buffer);
+			sync->arrive_and_wait();
+			if constexpr (Stats::enabled)
+				if (j == 0)
+				{
+					record.scatter_ns = radix_stats_ns<Stats>(phase);
+					record.bytes_moved = length * sizeof(*buffer);
+					stats->pass(record);
+				}
+			in_buffer = !in_buffer;
+			state = fuse ? radix_counter_state::fused : radix_counter_state::stale;
+		}
+	}
+	if constexpr (i + 1 < radix_size)
+	{
+		parallel_radix_sort_impl<i + 1>(ctx, j, in_buffer, state);
+	}
+	else if (in_buffer)
+	{
+		std::move(buffer + beg, buffer + end, first + beg);
+	}
+}
+
+//Grow-only scratch storage for the elements being sorted.
+//Trivially copyable elements are left uninitialized, anything else is default constructed so that it can be move assigned.
+template <typename T>
+class radix_scratch
+{
+public:
+	radix_scratch() = default;
+	radix_scratch(const radix_scratch&) = delete;
+	radix_scratch& operator=(const radix_scratch&) = delete;
+
+	~radix_scratch()
+	{
+		release();
+	}
+
+	T* reserve(size_t length)
+	{
+		if (length > capacity)
+		{
+			T* fresh;
+			if constexpr (std::is_trivially_copyable_v<T>)
+			{
+				fresh = std::allocator<T>().allocate(length);
+				untouched = true;
+			}
+			else
+			{
+				static_assert(std::is_default_constructible_v<T>, 
+					"radix sort needs a default constructible value_type or a user-supplied buffer");
+				fresh = new T[length];
+			}
+			release();
+			data = fresh;
+			capacity = length;
+		}
+		return data;
+	}
+
+	size_t size() const noexcept
+	{
+		return capacity;
+	}
+
+	//Whether nothing has been written to the storage since it was allocated, only the first call answers true
+	bool claim_untouched() noexcept
+	{
+		return std::exchange(untouched, false);
+	}
+
+private:
+	void release() noexcept
+	{
+		if constexpr (std::is_trivially_copyable_v<T>)
+		{
+			if (data != nullptr)
+				std::allocator<T>().deallocate(data, capacity);
+		}
+		else
+			delete[] data;
+		data = nullptr;
+		capacity = 0;
+	}
+
+	T* data = nullptr;
+	size_t capacity = 0;
+	bool untouched = false;
+};
+
+//Scratch elements and counters of a sort. Everything only grows, so a reused workspace stops allocating.
+template <typename T, typename Trait>
+class radix_workspace
+{
+public:
+	using counter_type = radix_counter<Trait, std::ptrdiff_t>;
+
+	template <typename Stats = radix_no_stats>
+	T* buffer(size_t length, Stats* stats = nullptr)
+	{
+		if constexpr (Stats::enabled)
+			if (length > scratch.size())
+				stats->allocate(length * sizeof(T));
+		return scratch.reserve(length);
+	}
+
+	template <typename cnt_type>
+	radix_histogram<Trait, cnt_type>& histogram()
+	{
+		if constexpr (std::is_same_v<cnt_type, int>)
+		{
+			if (!counter)
+				counter = std::make_unique<radix_histogram<Trait, int>>();
+			return *counter;
+		}
+		else
+		{
+			if (!wide_counter)
+				wide_counter = std::make_unique<radix_histogram<Trait, std::ptrdiff_t>>();
+			return *wide_counter;
+		}
+	}
+
+	void reserve_threads(unsigned int thrd_lim)
+	{
+		if (thrd_lim > thrd_cap)
+		{
+			thread_histogram = std::make_unique<radix_histogram<Trait, std::ptrdiff_t>[]>(thrd_lim);
+			thread_counter = std::make_unique<counter_type[]>(thrd_lim);
+			thrd_cap = thrd_lim;
+		}
+		//a sort on fewer threads may fuse where a larger one did not, so the slice counters grow on their own
+		if (radix_fusable<Trait>(thrd_lim) && thrd_lim > next_cap)
+		{
+			next_counter = std::make_unique<counter_type[]>(thrd_lim * thrd_lim);
+			next_cap = thrd_lim;
+		}
+	}
+
+	radix_scratch<T> scratch;
+	std::unique_ptr<radix_histogram<Trait, int>> counter;
+	std::unique_ptr<radix_histogram<Trait, std::ptrdiff_t>> wide_counter;
+	std::unique_ptr<radix_histogram<Trait, std::ptrdiff_t>[]> thread_histogram;
+	std::unique_ptr<counter_type[]> thread_counter, next_counter;
+	unsigned int thrd_cap = 0, next_cap = 0;
+	radix_scatter scatter = radix_scatter::automatic;
+	std::vector<uint32_t> domain_counter; //one counter per key of a counting sort
+};
+
+// ----------------------------------------------
+// Adaptive front-end: tiny or already ordered inputs finish without counting, and the thread count follows the
+// input size in bytes. The defaults were measured on x86-64, radix_calibrate measures them on the host.
+// ----------------------------------------------
+struct radix_tuning
+{
+	std::ptrdiff_t insertion_per_digit = 8;	//one compare keys up to 16 + this many elements per key digit are insertion sorted
+	std::ptrdiff_t insertion_max = 64;		//but never more than this many
+	std::ptrdiff_t insertion_digitwise = 64;	//keys compared digit by digit up to this many elements are insertion sorted
+	std::ptrdiff_t thread_bytes = 400000;	//least input per thread of a parallel sort, 100000 ints
+
+	//Radix sort pays a pass per digit, insertion sort a compare per step: a compare that walks the digits
+	//mostly stops at the first one, so its limit does not grow with the key length
+	template <typename Trait, typename T>
+	std::ptrdiff_t insertion_limit() const noexcept
+	{
+		if constexpr (radix_one_compare<Trait, T>)
+			return std::min(insertion_max, 16 + insertion_per_digit * std::ptrdiff_t(Trait::radix_size));
+		else
+			return insertion_digitwise;
+	}
+
+	template <typename T>
+	std::ptrdiff_t thread_length() const noexcept
+	{
+		return std::max<std::ptrdiff_t>(1024, thread_bytes / std::ptrdiff_t(sizeof(T)));
+	}
+
+	//Profile as written by save, fields missing from the file keep their value
+	bool load(const std::string& path)
+	{
+		std::ifstream in(path);
+		std::string key;
+		std::ptrdiff_t value;
+		while (in >> key >> value)
+		{
+			if (key == "insertion_per_digit")
+				insertion_per_digit = value;
+			else if (key == "insertion_max")
+				insertion_max = value;
+			else if (key == "insertion_digitwise")
+				insertion_digitwise = value;
+			else if (key == "thread_bytes")
+				thread_bytes = value;
+		}
+		return in.eof();
+	}
+
+	bool save(const std::string& path) const
+	{
+		std::ofstream out(path);
+		out << "insertion_per_digit " << insertion_per_digit << "\ninsertion_max " << insertion_max
+			<< "\ninsertion_digitwise " << insertion_digitwise << "\nthread_bytes " << thread_bytes << "\n";
+		return bool(out);
+	}
+};
+
+//Tuning used by every sort of the process, replace it before sorting starts on other threads
+inline radix_tuning& radix_host_tuning() noexcept
+{
+	static radix_tuning tuning;
+	return tuning;
+}
+
+//1 when [first, second) is sorted under Trait, -1 when it is strictly descending, so reversing it keeps the sort stable,
+//and 0 otherwise. A pair rules out one of the two orders, so the scan usually stops within the first elements.
+template <typename Trait, typename Iter>
+int radix_presorted(Iter first, Iter second)
+{
+	if (std::distance(first, second) < 2)
+		return 1;
+	bool ascending = !radix_less<Trait>(first[1], first[0]);
+	for (auto cur = first + 2; cur != second; ++cur)
+		if (radix_less<Trait>(cur[0], cur[-1]) == ascending)
+			return 0;
+	return ascending ? 1 : -1;
+}
+
+//Finish tiny and already ordered inputs without scratch, returns whether it did
+template <typename Trait, typename Iter>
+bool radix_sort_shortcut(Iter first, Iter second)
+{
+	using T = typename std::iterator_traits<Iter>::value_type;
+	if (std::distance(first, second) <= radix_host_tuning().template insertion_limit<Trait, T>())
+	{
+		radix_insertion_sort<Trait>(first, second);
+		return true;
+	}
+	auto order = radix_presorted<Trait>(first, second);
+	if (order < 0)
+		std::reverse(first, second);
+	return order != 0;
+}
+
+// ----------------------------------------------
+// Counting sort of keys of at most 16 bits that are the whole element: equal keys are equal elements,
+// so a histogram of the keys is enough to write the sorted range, with no scatter and no scratch
+// ----------------------------------------------
+template <typename Trait, typename T>
+concept radix_small_domain = (std::is_integral_v<T> || std::is_enum_v<T>) && sizeof(T) <= 2 &&
+	(std::is_same_v<Trait, radix_trait<T>> || std::is_same_v<Trait, radix_trait_greater<T>> ||
+	 std::is_same_v<Trait, radix_trait_reverse<radix_trait<T>>>);
+
+//Inputs from this length on are counted, below it walking the buckets costs more than the passes of radix_sort
+template <typename T>
+constexpr std::ptrdiff_t radix_counting_limit = std::ptrdiff_t(4) << (8 * sizeof(T));
+
+//Whole key of obj under a radix_small_domain trait
+template <typename Trait, typename T>
+uint32_t radix_small_key(const T& obj) noexcept
+{
+	uint32_t key = Trait::template get<0>(obj);
+	if constexpr (sizeof(T) == 2)
+		key |= uint32_t(Trait::template get<1>(obj)) << 8;
+	return key;
+}
+
+//The element of a key under a radix_small_domain trait
+template <typename Trait, typename T>
+T radix_small_value(uint32_t key) noexcept
+{
+	using U = std::conditional_t<sizeof(T) == 1, uint8_t, uint16_t>;
+	using Int = typename std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::type_identity<T>>::type;
+	auto bits = static_cast<U>(std::is_same_v<Trait, radix_trait<T>> ? key : ~key);
+	if constexpr (std::is_signed_v<Int>)
+		bits ^= U(1) << (8 * sizeof(T) - 1);
+	if constexpr (std::is_same_v<T, bool>)
+		return bits != 0;
+	else
+		return std::bit_cast<T>(bits);
+}
+
+template <typename Trait, typename Iter>
+void radix_counting_sort(Iter first, Iter second, std::vector<uint32_t>& counter)
+{
+	using T = typename std::iterator_traits<Iter>::value_type;
+	constexpr size_t domain = size_t(1) << (8 * sizeof(T));
+	if constexpr (sizeof(T) == 1)
+	{
+		//four histograms, so that runs of one key (status codes, flags) do not wait on a single counter
+		counter.assign(4 * domain, 0);
+		auto length = std::distance(first, second);
+		auto it = first;
+		for (std::ptrdiff_t k = length / 4; k > 0; --k, it += 4)
+		{
+			++counter[radix_small_key<Trait>(it[0])];
+			++counter[domain + radix_small_key<Trait>(it[1])];
+			++counter[2 * domain + radix_small_key<Trait>(it[2])];
+			++counter[3 * domain + radix_small_key<Trait>(it[3])];
+		}
+		for (; it != second; ++it)
+			++counter[radix_small_key<Trait>(*it)];
+		for (size_t key = 0; key < domain; ++key)
+			counter[key] += counter[domain + key] + counter[2 * domain + key] + counter[3 * domain + key];
+	}
+	else
+	{
+		counter.assign(domain, 0);
+		for (auto it = first; it != second; ++it)
+			++counter[radix_small_key<Trait>(*it)];
+	}
+	for (size_t key = 0; key < domain; ++key)
+		if (counter[key] != 0)
+			first = std::fill_n(first, counter[key], radix_small_value<Trait, T>(static_cast<uint32_t>(key)));
+}
+
+//Sort the encoded keys on the counters of workspace, which have the same layout for the keys and their encoding
+template <typename Trait, typename Iter, typename Stats>
+void radix_sort_encoded_run(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer,
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait>& workspace, radix_scatter scatter, Stats* stats)
+{
+	using T = typename std::iterator_traits<Iter>::value_type;
+	auto length = std::distance(first, second);
+	T* data = std::to_address(first);
+	radix_encode<false>(data, length);
+	if (length <= INT_MAX)
+		radix_sort_impl<0, radix_trait_encoded<T>>(data, data + length, buffer, workspace.template histogram<int>(), 
+			scatter, false, stats);
+	else
+		radix_sort_impl<0, radix_trait_encoded<T>>(data, data + length, buffer, workspace.template histogram<std::ptrdiff_t>(), 
+			scatter, false, stats);
+	radix_encode<true>(data, length);
+}
+
+template <typename Trait, typename Iter, typename Stats = radix_no_stats>
+void radix_sort_run(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer,
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait>& workspace, Stats* stats = nullptr)
+{
+	[[maybe_unused]] auto start = radix_stats_now<Stats>();
+	auto length = std::distance(first, second);
+	if constexpr (Stats::enabled)
+		stats->begin(length, 1);
+	bool counted = false;
+	if constexpr (radix_small_domain<Trait, typename std::iterator_traits<Iter>::value_type>)
+	{
+		using T = typename std::iterator_traits<Iter>::value_type;
+		counted = length >= radix_counting_limit<T> && length >= radix_host_tuning().template insertion_limit<Trait, T>() &&
+			length <= std::ptrdiff_t(UINT32_MAX);
+		if (counted)
+			radix_counting_sort<Trait>(first, second, workspace.domain_counter);
+	}
+	if (!counted && !radix_sort_shortcut<Trait>(first, second))
+	{
+		if (buffer == nullptr)
+			buffer = workspace.buffer(length, stats);
+		auto scatter = resolve_scatter<typename std::iterator_traits<Iter>::value_type>(workspace.scatter, length);
+		bool encoded = false;
+		if constexpr (radix_encodable<Trait, Iter>)
+		{
+			encoded = length * sizeof(*buffer) >= radix_encode_bytes;
+			if (encoded)
+				radix_sort_encoded_run<Trait>(first, second, buffer, workspace, scatter, stats);
+		}
+		if (!encoded)
+		{
+			if (length <= INT_MAX) //int is enough for counter
+				radix_sort_impl<0, Trait, Iter>(first, second, buffer, workspace.template histogram<int>(), scatter, false, stats);
+			else
+				radix_sort_impl<0, Trait, Iter>(first, second, buffer, workspace.template histogram<std::ptrdiff_t>(), scatter, false, stats);
+		}
+	}
+	if constexpr (Stats::enabled)
+		stats->end(radix_stats_ns<Stats>(start));
+}
+
+//Threads worth using for length elements of type T
+template <typename T>
+unsigned int parallel_thread_limit(std::ptrdiff_t length, unsigned int thrd_lim)
+{
+	auto thrd_sort_length_limit = radix_host_tuning().template thread_length<T>(); //each thread's min sort length
+	return static_cast<unsigned int>(std::min<std::ptrdiff_t>(thrd_lim, std::max<std::ptrdiff_t>(1, length / thrd_sort_length_limit)));
+}
+
+template <typename Trait, typename Iter, typename Stats = radix_no_stats>
+void parallel_radix_sort_run(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer,
+	unsigned int thrd_lim, radix_thread_pool& pool,
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait>& workspace, Stats* stats = nullptr)
+{
+	using namespace std;
+	[[maybe_unused]] auto start = radix_stats_now<Stats>();
+	auto length = distance(first, second);
+	thrd_lim = parallel_thread_limit<typename iterator_traits<Iter>::value_type>(length, thrd_lim);
+	//a counting sort runs at memory speed on one thread
+	if (thrd_lim <= 1 || radix_small_domain<Trait, typename iterator_traits<Iter>::value_type>)
+		return radix_sort_run<Trait>(first, second, buffer, workspace, stats);
+	if constexpr (Stats::enabled)
+		stats->begin(length, thrd_lim);
+	if (radix_sort_shortcut<Trait>(first, second))
+	{
+		if constexpr (Stats::enabled)
+			stats->end(radix_stats_ns<Stats>(start));
+		return;
+	}
+	bool touch = false;
+	if (buffer == nullptr)
+	{
+		buffer = workspace.buffer(length, stats);
+		touch = pool.numa_aware() && workspace.scratch.claim_untouched();
+	}
+	//Bounds of the slice of thread j. Fresh scratch is placed by the thread that reads the slice back from it.
+	auto slice = [&](unsigned int j) {
+		ptrdiff_t beg = j * (length / thrd_lim), end = j + 1 == thrd_lim ? length : beg + length / thrd_lim;
+		if (touch)
+			radix_first_touch(buffer + beg, end - beg);
+		return pair{ beg, end };
+	};
+	//cnt type optimize seems negative in multi-thread?
+	workspace.reserve_threads(thrd_lim);
+	radix_barrier sync(thrd_lim);
+	auto scatter = resolve_scatter<typename iterator_traits<Iter>::value_type>(workspace.scatter, length);
+	bool encoded = false;
+	if constexpr (radix_encodable<Trait, Iter>)
+	{
+		encoded = length * sizeof(*buffer) >= radix_encode_bytes;
+		if (encoded)
+		{
+			//every thread encodes the slice it counts first and decodes the slice it moves back last
+			using T = typename iterator_traits<Iter>::value_type;
+			auto data = std::to_address(first);
+			parallel_radix_context<T*, radix_trait_encoded<T>, ptrdiff_t, Stats> ctx{ data, buffer, length, 
+				length / thrd_lim, thrd_lim, workspace.thread_histogram.get(), workspace.thread_counter.get(), 
+				workspace.next_counter.get(), scatter, &sync, stats };
+			pool.run(thrd_lim, [&](unsigned int j) {
+				auto [beg, end] = slice(j);
+				radix_encode<false>(data + beg, end - beg);
+				parallel_radix_sort_impl<0>(ctx, j);
+				radix_encode<true>(data + beg, end - beg);
+			});
+		}
+	}
+	if (!encoded)
+	{
+		parallel_radix_context<Iter, Trait, ptrdiff_t, Stats> ctx{ first, buffer, length, length / thrd_lim, thrd_lim,
+			workspace.thread_histogram.get(), workspace.thread_counter.get(), workspace.next_counter.get(), scatter, &sync, stats };
+		pool.run(thrd_lim, [&](unsigned int j) {
+			slice(j);
+			parallel_radix_sort_impl<0>(ctx, j);
+		});
+	}
+	if constexpr (Stats::enabled)
+		stats->end(radix_stats_ns<Stats>(start));
+}
+
+template <typename Trait, typename Iter>
+void parallel_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr,
+	unsigned int thrd_lim = std::thread::hardware_concurrency(),
+	radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait> workspace;
+	parallel_radix_sort_run<Trait>(first, second, buffer, thrd_lim, pool, workspace);
+}
+
+//Sort on the workers of pool, using all of its threads
+template <typename Trait, typename Iter>
+void parallel_radix_sort(Iter first, Iter second, radix_thread_pool& pool,
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	parallel_radix_sort<Trait>(first, second, buffer, pool.size(), pool);
+}
+
+template <typename Iter>
+void parallel_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr, 
+	unsigned int thrd_lim = std::thread::hardware_concurrency())
+{
+	parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer, thrd_lim);
+}
+
+template <typename Iter>
+void parallel_radix_sort(Iter first, Iter second, radix_thread_pool& pool,
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, pool, buffer);
+}
+
+//Sort on the workers of pool, recording per-pass statistics into stats (see radix_sort_stats)
+template <typename Trait, typename Iter, radix_stats_observer Stats>
+void parallel_radix_sort(Iter first, Iter second, radix_thread_pool& pool, Stats& stats)
+{
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait> workspace;
+	parallel_radix_sort_run<Trait>(first, second, nullptr, pool.size(), pool, workspace, &stats);
+}
+
+template <typename Iter, radix_stats_observer Stats>
+void parallel_radix_sort(Iter first, Iter second, radix_thread_pool& pool, Stats& stats)
+{
+	parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, pool, stats);
+}
+
+template <typename Trait, typename Iter>
+void radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait> workspace;
+	radix_sort_run<Trait>(first, second, buffer, workspace);
+}
+
+template <typename Iter>
+void radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+}
+
+//Sort recording per-pass statistics into stats (see radix_sort_stats)
+template <typename Trait, typename Iter, radix_stats_observer Stats>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, Stats& stats)
+{
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait> workspace;
+	radix_sort_run<Trait>(first, second, buffer, workspace, &stats);
+}
+
+template <typename Iter, radix_stats_observer Stats>
+void radix_sort(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, Stats& stats)
+{
+	radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer, stats);
+}
+
+template <typename Iter, typename ExecutionPolicy>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy,
+	 typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	// 添加 (void)policy 来消除警告
+	(void)policy;
+
+	if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, \
+		std::execution::parallel_policy> || std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, \
+		std::execution::parallel_unsequenced_policy>)
+		parallel_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+	else
+		radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+}
+
+template <typename Trait, typename Iter, typename ExecutionPolicy>
+void radix_sort(Iter first, Iter second, ExecutionPolicy&& policy, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	// 添加 (void)policy 来消除警告
 	(void)policy;
 	
 	if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy> || \
 		 std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>)
 		parallel_radix_sort<Trait>(first, second, buffer);
 	else
-		radix_sort<Trait>(first, second, buffer);
+		radix_sort<Trait>(first, second, buffer);
+}
+//Measure radix_tuning on this host with random keys of type T: the longest input that insertion sort still sorts faster,
+//and the shortest slice per thread at which two threads of pool beat one (never, on a single core). The insertion limit
+//lands in the field of T's compare kind, one compare or digit by digit, so calibrating a key of each kind in turn
+//(passing the previous result as radix_host_tuning()) fills both. It takes under a second, and the result is meant to be
+//saved once and loaded into radix_host_tuning() at startup.
+template <typename T, typename Trait = radix_trait<T>>
+radix_tuning radix_calibrate(radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	using namespace std;
+	static_assert(is_trivially_copyable_v<T>, "radix_calibrate fills keys with random bytes");
+	constexpr std::ptrdiff_t max_slice = std::ptrdiff_t(1) << 20;
+	vector<T> input(2 * max_slice), data(input.size());
+	uint64_t seed = 0x9E3779B97F4A7C15ull;
+	for (auto& x : input)
+	{
+		unsigned char bytes[sizeof(T)];
+		for (auto& b : bytes)
+		{
+			seed ^= seed << 13, seed ^= seed >> 7, seed ^= seed << 17;
+			b = static_cast<unsigned char>(seed);
+		}
+		memcpy(&x, bytes, sizeof(T));
+	}
+	//best of three runs of sort over copies of the first length keys, in ns
+	auto time = [&](std::ptrdiff_t length, auto&& sort) {
+		double best = numeric_limits<double>::max();
+		for (int r = 0; r < 3; ++r)
+		{
+			copy(input.begin(), input.begin() + length, data.begin());
+			auto beg = chrono::steady_clock::now();
+			sort(data.data(), length);
+			best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - beg).count());
+		}
+		return best;
+	};
+	radix_tuning tuning = radix_host_tuning();
+	radix_workspace<T, Trait> workspace;
+	auto buffer = workspace.buffer(input.size());
+
+	//many short inputs in a row, as a batch of small sorts would see them
+	std::ptrdiff_t insertion = 0;
+	for (std::ptrdiff_t n = 8; n <= 256; n += 8)
+	{
+		auto batch = 16384 / n * n;
+		auto insertion_ns = time(batch, [&](T* keys, std::ptrdiff_t length) {
+			for (std::ptrdiff_t k = 0; k < length; k += n)
+				radix_insertion_sort<Trait>(keys + k, keys + k + n);
+		});
+		auto radix_ns = time(batch, [&](T* keys, std::ptrdiff_t length) {
+			for (std::ptrdiff_t k = 0; k < length; k += n)
+				radix_sort_impl<0, Trait>(keys + k, keys + k + n, buffer, workspace.template histogram<int>());
+		});
+		if (insertion_ns > radix_ns)
+			break;
+		insertion = n;
+	}
+	if constexpr (radix_one_compare<Trait, T>)
+	{
+		tuning.insertion_per_digit = max<std::ptrdiff_t>(0, insertion - 16) / std::ptrdiff_t(Trait::radix_size);
+		tuning.insertion_max = max(tuning.insertion_max, insertion);
+	}
+	else
+		tuning.insertion_digitwise = insertion;
+
+	tuning.thread_bytes = numeric_limits<std::ptrdiff_t>::max();
+	if (pool.size() >= 2)
+	{
+		workspace.reserve_threads(2);
+		for (std::ptrdiff_t slice = 4096; slice <= max_slice; slice *= 2)
+		{
+			auto one_ns = time(2 * slice, [&](T* keys, std::ptrdiff_t length) {
+				radix_sort_impl<0, Trait>(keys, keys + length, buffer, workspace.template histogram<int>());
+			});
+			auto two_ns = time(2 * slice, [&](T* keys, std::ptrdiff_t length) {
+				radix_barrier sync(2);
+				parallel_radix_context<T*, Trait, std::ptrdiff_t> ctx{ keys, buffer, length, slice, 2, workspace.thread_histogram.get(),
+					workspace.thread_counter.get(), workspace.next_counter.get(), radix_scatter::direct, &sync, nullptr };
+				pool.run(2, [&](unsigned int j) {
+					parallel_radix_sort_impl<0>(ctx, j);
+				});
+			});
+			if (two_ns < one_ns)
+			{
+				tuning.thread_bytes = slice * std::ptrdiff_t(sizeof(T));
+				break;
+			}
+		}
+	}
+	return tuning;
+}
+
+
+constexpr std::ptrdiff_t msd_insertion_limit = 32; //buckets up to this length finish with insertion sort
+constexpr std::ptrdiff_t msd_lsd_limit = 2048; //buckets up to this length fit in L1, where LSD beats another level
+
+//Stable MSD pass on digit i - 1 of [first, second). The elements are in buffer when in_buffer is set and end up in
+//[first, second): every level scatters into the other array, and each bucket recurses on the next digit down.
+template <size_t i, typename Trait, typename Iter>
+void msd_radix_sort_impl(Iter first, Iter second, typename std::iterator_traits<Iter>::value_type* buffer, bool in_buffer)
+{
+	using namespace std;
+	static_assert(radix_count_v<Trait> <= 2048, "MSD sorts keep a counter per level on the stack, use narrower digits");
+	auto length = distance(first, second);
+	if (in_buffer && (i == 0 || length <= msd_lsd_limit))
+	{
+		std::move(buffer, buffer + length, first);
+		in_buffer = false;
+	}
+	if constexpr (i == 0)
+		return;
+	else
+	{
+		if (length <= msd_insertion_limit)
+			return radix_insertion_sort<Trait, i>(first, second);
+		if (length <= msd_lsd_limit)
+		{
+			radix_histogram<radix_trait_low<Trait, i>, int> counter;
+			return radix_sort_impl<0, radix_trait_low<Trait, i>>(first, second, buffer, counter);
+		}
+		radix_counter<Trait, std::ptrdiff_t> counter{};
+		if (in_buffer)
+			count_duff_device<i - 1, Trait>(buffer, buffer + length, counter);
+		else
+			count_duff_device<i - 1, Trait>(first, second, counter);
+		if (*max_element(counter.begin(), counter.end()) == length)
+			return msd_radix_sort_impl<i - 1, Trait>(first, second, buffer, in_buffer);
+		for (size_t k = 1; k < radix_count_v<Trait>; ++k)
+			counter[k] += counter[k - 1];
+		if (in_buffer)
+			place_duff_device<i - 1, Trait>(buffer, first, counter, 0, length);
+		else
+			place_duff_device<i - 1, Trait>(first, buffer, counter, 0, length);
+		//the scatter leaves every counter at the start of its bucket
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			auto beg = counter[k], end = k + 1 < radix_count_v<Trait> ? counter[k + 1] : length;
+			if (end - beg > 0)
+				msd_radix_sort_impl<i - 1, Trait>(first + beg, first + end, buffer + beg, !in_buffer);
+		}
+	}
+}
+
+//Stable MSD radix sort: it partitions on the most significant digit and recurses per bucket, so it stops as soon
+//as buckets become small instead of always running every digit, and small buckets finish with LSD or insertion sort
+template <typename Trait, typename Iter>
+void msd_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	radix_scratch<typename std::iterator_traits<Iter>::value_type> resource;
+	if (buffer == nullptr)
+		buffer = resource.reserve(std::distance(first, second));
+	msd_radix_sort_impl<Trait::radix_size, Trait>(first, second, buffer, false);
+}
+
+template <typename Iter>
+void msd_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	msd_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+}
+
+//American flag pass on digit i - 1: elements are swapped into their buckets in place, then each bucket recurses
+template <size_t i, typename Trait, typename Iter>
+void inplace_radix_sort_impl(Iter first, Iter second)
+{
+	using namespace std;
+	static_assert(radix_count_v<Trait> <= 2048, "MSD sorts keep a counter per level on the stack, use narrower digits");
+	auto length = distance(first, second);
+	if constexpr (i > 0)
+	{
+		if (length <= msd_insertion_limit)
+			return radix_insertion_sort<Trait, i>(first, second);
+		radix_counter<Trait, std::ptrdiff_t> head{}, tail;
+		count_duff_device<i - 1, Trait>(first, second, head);
+		if (*max_element(head.begin(), head.end()) == length)
+			return inplace_radix_sort_impl<i - 1, Trait>(first, second);
+		std::ptrdiff_t sum = 0;
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			sum += head[k];
+			tail[k] = sum;
+			head[k] = sum - head[k];
+		}
+		//every swap moves one element into its own bucket for good
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			while (head[k] < tail[k])
+			{
+				size_t t = Trait::template get<i - 1>(first[head[k]]);
+				if (t == k)
+					++head[k];
+				else
+					std::iter_swap(first + head[k], first + head[t]++);
+			}
+		}
+		if constexpr (i > 1)
+		{
+			std::ptrdiff_t beg = 0;
+			for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+			{
+				if (tail[k] - beg > 1)
+					inplace_radix_sort_impl<i - 1, Trait>(first + beg, first + tail[k]);
+				beg = tail[k];
+			}
+		}
+	}
+}
+
+//In-place MSD radix sort (American flag sort): needs no buffer, but is not stable
+template <typename Trait, typename Iter>
+void inplace_radix_sort(Iter first, Iter second)
+{
+	inplace_radix_sort_impl<Trait::radix_size, Trait>(first, second);
+}
+
+template <typename Iter>
+void inplace_radix_sort(Iter first, Iter second)
+{
+	inplace_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+}
+
+//Selection on digit i - 1: the elements are split three ways around the digit of the bucket holding nth,
+//and only that bucket is searched on the digits below
+template <size_t i, typename Trait, typename Iter>
+void radix_select_impl(Iter first, Iter nth, Iter second)
+{
+	using namespace std;
+	if constexpr (i > 0)
+	{
+		auto length = distance(first, second);
+		if (length <= msd_insertion_limit)
+			return radix_insertion_sort<Trait, i>(first, second);
+		radix_counter<Trait, std::ptrdiff_t> counter{};
+		count_duff_device<i - 1, Trait>(first, second, counter);
+		auto rank = distance(first, nth);
+		size_t target = 0;
+		for (std::ptrdiff_t below = 0; below + counter[target] <= rank; ++target)
+			below += counter[target];
+		if (counter[target] == length)
+			return radix_select_impl<i - 1, Trait>(first, nth, second);
+		Iter less = first, cur = first, greater = second;
+		while (cur != greater)
+		{
+			size_t t = Trait::template get<i - 1>(*cur);
+			if (t < target)
+				std::iter_swap(less++, cur++);
+			else if (t > target)
+				std::iter_swap(cur, --greater);
+			else
+				++cur;
+		}
+		radix_select_impl<i - 1, Trait>(less, nth, greater);
+	}
+}
+
+//Radix nth_element: the element of rank nth - first under Trait is put at nth, the ones before it are not larger
+//and the ones after it not smaller. It costs a count and a partition on every digit of a shrinking range, not stable.
+template <typename Trait, typename Iter>
+void radix_select(Iter first, Iter nth, Iter second)
+{
+	if (nth != second)
+		radix_select_impl<Trait::radix_size, Trait>(first, nth, second);
+}
+
+template <typename Iter>
+void radix_select(Iter first, Iter nth, Iter second)
+{
+	radix_select<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, nth, second);
+}
+
+//Radix partial_sort: the middle - first smallest elements under Trait end up sorted in [first, middle),
+//the rest in no particular order
+template <typename Trait, typename Iter>
+void radix_partial_sort(Iter first, Iter middle, Iter second)
+{
+	radix_select<Trait>(first, middle, second);
+	msd_radix_sort<Trait>(first, middle);
+}
+
+template <typename Iter>
+void radix_partial_sort(Iter first, Iter middle, Iter second)
+{
+	radix_partial_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, middle, second);
+}
+
+//The k largest elements under Trait moved to the front in descending order, returns the end of them
+template <typename Trait, typename Iter>
+Iter radix_top_k(Iter first, Iter second, size_t k)
+{
+	auto middle = first + static_cast<std::ptrdiff_t>(std::min<size_t>(std::distance(first, second), k));
+	radix_partial_sort<radix_trait_reverse<Trait>>(first, middle, second);
+	return middle;
+}
+
+template <typename Iter>
+Iter radix_top_k(Iter first, Iter second, size_t k)
+{
+	return radix_top_k<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, k);
+}
+
+// ----------------------------------------------
+// Segmented sort: independent ranges laid out back to back, given by the offset of each one's start
+// ----------------------------------------------
+constexpr std::ptrdiff_t segment_batch_length = std::ptrdiff_t(1) << 15; //least elements per batch of segments taken by a thread
+
+//Bounds of the segments starting at offsets, the last one ends at length
+template <typename OffsetIter>
+void radix_segment_bounds(OffsetIter offsets_first, OffsetIter offsets_second, std::ptrdiff_t length, std::vector<std::ptrdiff_t>& bounds)
+{
+	bounds.clear();
+	for (; offsets_first != offsets_second; ++offsets_first)
+		bounds.push_back(static_cast<std::ptrdiff_t>(*offsets_first));
+	if (!bounds.empty())
+		bounds.push_back(length);
+}
+
+//Sort the segments between bounds one after another on workspace: tiny ones are insertion sorted and
+//ordered ones only scanned by the front-end of radix_sort_run, the others share its scratch buffer
+template <typename Trait, typename Iter>
+void radix_sort_segments(Iter first, const std::ptrdiff_t* bounds, size_t segment_cnt,
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait>& workspace)
+{
+	for (size_t k = 0; k < segment_cnt; ++k)
+		if (bounds[k + 1] - bounds[k] > 1)
+			radix_sort_run<Trait>(first + bounds[k], first + bounds[k + 1], nullptr, workspace);
+}
+
+//Sort every segment of [first, second) on its own: segment k starts at first + offsets[k] and ends where the next one
+//starts, the last one at second. Offsets are increasing, elements before the first segment are left alone.
+template <typename Trait, typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter first, Iter second, OffsetIter offsets_first, OffsetIter offsets_second)
+{
+	std::vector<std::ptrdiff_t> bounds;
+	radix_segment_bounds(offsets_first, offsets_second, std::distance(first, second), bounds);
+	radix_workspace<typename std::iterator_traits<Iter>::value_type, Trait> workspace;
+	if (!bounds.empty())
+		radix_sort_segments<Trait>(first, bounds.data(), bounds.size() - 1, workspace);
+}
+
+template <typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter first, Iter second, OffsetIter offsets_first, OffsetIter offsets_second)
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, offsets_first, offsets_second);
+}
+
+//Segmented sort on up to thrd_lim threads of pool. Segments holding at least a thread's share of the elements are sorted
+//first by all threads, the others are cut into batches of consecutive segments of similar total length,
+//which the threads take in turn, each on a scratch buffer of its own.
+template <typename Trait, typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter first, Iter second, OffsetIter offsets_first, OffsetIter offsets_second,
+	unsigned int thrd_lim, radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	using namespace std;
+	using T = typename iterator_traits<Iter>::value_type;
+	vector<std::ptrdiff_t> bounds;
+	radix_segment_bounds(offsets_first, offsets_second, distance(first, second), bounds);
+	if (bounds.empty())
+		return;
+	auto total = bounds.back() - bounds.front();
+	thrd_lim = parallel_thread_limit<T>(total, thrd_lim);
+	radix_workspace<T, Trait> workspace;
+	if (thrd_lim <= 1)
+		return radix_sort_segments<Trait>(first, bounds.data(), bounds.size() - 1, workspace);
+
+	auto share = total / thrd_lim;
+	auto batch_length = max(segment_batch_length, total / (8 * std::ptrdiff_t(thrd_lim)));
+	vector<size_t> batches{ 0 }; //first segment of every batch, and the end of the last one
+	std::ptrdiff_t fill = 0;
+	for (size_t k = 0; k + 1 < bounds.size(); ++k)
+	{
+		auto length = bounds[k + 1] - bounds[k];
+		if (length >= share)
+		{
+			parallel_radix_sort_run<Trait>(first + bounds[k], first + bounds[k + 1], nullptr, thrd_lim, pool, workspace);
+			//the segment closes the batch before it and stands alone
+			if (batches.back() != k)
+				batches.push_back(k);
+			batches.push_back(k + 1);
+			fill = 0;
+			continue;
+		}
+		fill += length;
+		if (fill >= batch_length)
+		{
+			batches.push_back(k + 1);
+			fill = 0;
+		}
+	}
+	if (batches.back() != bounds.size() - 1)
+		batches.push_back(bounds.size() - 1);
+
+	vector<radix_workspace<T, Trait>> thread_workspace(thrd_lim);
+	atomic<size_t> next{ 0 };
+	pool.run(thrd_lim, [&](unsigned int j) {
+		for (size_t b; (b = next.fetch_add(1, memory_order_relaxed)) + 1 < batches.size();)
+		{
+			auto beg = batches[b], end = batches[b + 1];
+			//a lone segment of a whole share has been sorted already
+			if (end - beg == 1 && bounds[end] - bounds[beg] >= share)
+				continue;
+			radix_sort_segments<Trait>(first, bounds.data() + beg, end - beg, thread_workspace[j]);
+		}
+	});
+}
+
+template <typename Iter, typename OffsetIter>
+void segmented_radix_sort(Iter first, Iter second, OffsetIter offsets_first, OffsetIter offsets_second,
+	unsigned int thrd_lim, radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	segmented_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, offsets_first, offsets_second,
+		thrd_lim, pool);
+}
+
+//Buckets above this length are partitioned again by the thread that takes them, smaller ones are sorted right away
+constexpr std::ptrdiff_t msd_split_limit = std::ptrdiff_t(1) << 16;
+
+//A bucket still to be sorted on its digits below digits, it is in the buffer when in_buffer is set
+struct radix_msd_task
+{
+	std::ptrdiff_t beg, end;
+	std::size_t digits;
+	bool in_buffer;
+};
+
+//Tasks of one thread: the owner takes the newest from the back, other threads steal the oldest from the front
+template <typename Task>
+class radix_steal_queue
+{
+public:
+	void push(const Task& task)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		tasks.push_back(task);
+	}
+
+	bool pop(Task& task)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (tasks.empty())
+			return false;
+		task = tasks.back();
+		tasks.pop_back();
+		return true;
+	}
+
+	bool steal(Task& task)
+	{
+		std::lock_guard<std::mutex> lock(mtx);
+		if (tasks.empty())
+			return false;
+		task = tasks.front();
+		tasks.pop_front();
+		return true;
+	}
+
+private:
+	std::mutex mtx;
+	std::deque<Task> tasks;
+};
+
+//Shared by the threads of one parallel MSD sort
+template <typename Iter, typename Trait>
+struct parallel_msd_context
+{
+	Iter first;
+	typename std::iterator_traits<Iter>::value_type* buffer;
+	std::ptrdiff_t length, parallel_width;
+	unsigned int thrd_lim;
+	radix_histogram<Trait, std::ptrdiff_t>* histogram;
+	radix_steal_queue<radix_msd_task>* queue;
+	std::atomic<std::ptrdiff_t>* outstanding;	//tasks queued or running
+	radix_scatter scatter;
+	radix_barrier* sync;
+};
+
+//Sort the bucket of task on thread j. A small bucket finishes with LSD or insertion sort on its remaining digits,
+//a large one is partitioned on its next digit into the other array and its buckets are queued on thread j.
+template <size_t i, typename Iter, typename Trait>
+void parallel_msd_task(const parallel_msd_context<Iter, Trait>& ctx, unsigned int j, radix_msd_task task)
+{
+	using namespace std;
+	if constexpr (i > 0)
+	{
+		if (task.digits != i)
+			return parallel_msd_task<i - 1>(ctx, j, task);
+		auto first = ctx.first + task.beg, second = ctx.first + task.end;
+		auto buffer = ctx.buffer + task.beg;
+		auto length = task.end - task.beg;
+		if (length <= msd_split_limit)
+		{
+			if (task.in_buffer)
+				std::move(buffer, buffer + length, first);
+			if (length <= msd_insertion_limit)
+				return radix_insertion_sort<Trait, i>(first, second);
+			radix_histogram<radix_trait_low<Trait, i>, int> counter;
+			return radix_sort_impl<0, radix_trait_low<Trait, i>>(first, second, buffer, counter);
+		}
+		radix_counter<Trait, std::ptrdiff_t> counter{};
+		if (task.in_buffer)
+			count_duff_device<i - 1, Trait>(buffer, buffer + length, counter);
+		else
+			count_duff_device<i - 1, Trait>(first, second, counter);
+		if (*max_element(counter.begin(), counter.end()) == length)
+		{
+			task.digits = i - 1;
+			if (i > 1)
+				return parallel_msd_task<i - 1>(ctx, j, task);
+			if (task.in_buffer)
+				std::move(buffer, buffer + length, first);
+			return;
+		}
+		for (size_t k = 1; k < radix_count_v<Trait>; ++k)
+			counter[k] += counter[k - 1];
+		if (task.in_buffer)
+			place_duff_device<i - 1, Trait>(buffer, first, counter, 0, length);
+		else
+			place_duff_device<i - 1, Trait>(first, buffer, counter, 0, length);
+		//the scatter leaves every counter at the start of its bucket
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			auto beg = counter[k], end = k + 1 < radix_count_v<Trait> ? counter[k + 1] : length;
+			if (end - beg <= 0)
+				continue;
+			if (i == 1)
+			{
+				if (!task.in_buffer)
+					std::move(buffer + beg, buffer + end, first + beg);
+				continue;
+			}
+			ctx.outstanding->fetch_add(1, std::memory_order_relaxed);
+			ctx.queue[j].push({ task.beg + beg, task.beg + end, i - 1, !task.in_buffer });
+		}
+	}
+}
+
+//Thread j's part of the partition on the most significant digit below i that is not shared by every key, followed by
+//running and stealing bucket tasks until none are left. The histograms of every slice are counted already.
+template <size_t i, typename Iter, typename Trait>
+void parallel_msd_split(const parallel_msd_context<Iter, Trait>& ctx, unsigned int j)
+{
+	using namespace std;
+	if constexpr (i > 0)
+	{
+		auto [first, buffer, length, parallel_width, thrd_lim, histogram, queue, outstanding, scatter, sync] = ctx;
+		if (trivial_digit<i - 1, Trait>(length, histogram, thrd_lim))
+			return parallel_msd_split<i - 1>(ctx, j);
+		size_t beg = j * parallel_width, end = j + 1 == thrd_lim ? length : beg + parallel_width;
+		//every thread works out the bucket bounds, and the end of its own share of every bucket
+		radix_counter<Trait, std::ptrdiff_t> start, counter;
+		std::ptrdiff_t sum = 0;
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			start[k] = sum;
+			for (auto t = 0u; t < thrd_lim; ++t)
+			{
+				sum += histogram[t][i - 1][k];
+				if (t == j)
+					counter[k] = sum;
+			}
+		}
+		place_pass<i - 1, Trait>(first, buffer, counter, beg, end, scatter);
+		sync->arrive_and_wait();
+
+		//a bucket starts on the thread whose slice its start falls in, which keeps it next to the scratch the thread placed
+		std::ptrdiff_t queued = 0;
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			auto bucket_end = k + 1 < radix_count_v<Trait> ? start[k + 1] : length;
+			if (bucket_end == start[k] || min<std::ptrdiff_t>(start[k] / parallel_width, thrd_lim - 1) != j)
+				continue;
+			if (i == 1 || bucket_end - start[k] == 1)
+				std::move(buffer + start[k], buffer + bucket_end, first + start[k]);
+			else
+			{
+				queue[j].push({ start[k], bucket_end, i - 1, true });
+				++queued;
+			}
+		}
+		outstanding->fetch_add(queued, std::memory_order_relaxed);
+		sync->arrive_and_wait();
+
+		radix_msd_task task;
+		for (;;)
+		{
+			bool found = queue[j].pop(task);
+			for (auto t = 1u; !found && t < thrd_lim; ++t)
+				found = queue[(j + t) % thrd_lim].steal(task);
+			if (found)
+			{
+				parallel_msd_task<Trait::radix_size>(ctx, j, task);
+				outstanding->fetch_sub(1, std::memory_order_acq_rel);
+			}
+			else if (outstanding->load(std::memory_order_acquire) == 0)
+				break;
+			else
+				std::this_thread::yield();
+		}
+	}
+}
+
+//Parallel stable MSD radix sort. One parallel pass partitions on the most significant digit that is not shared by
+//every key, then each bucket is sorted by a single thread with no barrier per digit. Large buckets are partitioned
+//again and idle threads steal queued buckets, so skewed keys keep every thread busy.
+template <typename Trait, typename Iter>
+void parallel_msd_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr,
+	unsigned int thrd_lim = std::thread::hardware_concurrency(),
+	radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	using namespace std;
+	static_assert(radix_count_v<Trait> <= 2048, "MSD sorts keep a counter per level on the stack, use narrower digits");
+	auto length = distance(first, second);
+	thrd_lim = parallel_thread_limit<typename iterator_traits<Iter>::value_type>(length, thrd_lim);
+	if (thrd_lim <= 1)
+		return msd_radix_sort<Trait>(first, second, buffer);
+	radix_scratch<typename iterator_traits<Iter>::value_type> resource;
+	bool touch = false;
+	if (buffer == nullptr)
+	{
+		buffer = resource.reserve(length);
+		touch = pool.numa_aware() && resource.claim_untouched();
+	}
+	auto histogram = make_unique<radix_histogram<Trait, std::ptrdiff_t>[]>(thrd_lim);
+	auto queue = make_unique<radix_steal_queue<radix_msd_task>[]>(thrd_lim);
+	atomic<std::ptrdiff_t> outstanding{ 0 };
+	radix_barrier sync(thrd_lim);
+	parallel_msd_context<Iter, Trait> ctx{ first, buffer, length, length / thrd_lim, thrd_lim, histogram.get(), queue.get(), 
+		&outstanding, resolve_scatter<typename iterator_traits<Iter>::value_type>(radix_scatter::automatic, length), &sync };
+	pool.run(thrd_lim, [&](unsigned int j) {
+		std::ptrdiff_t beg = j * ctx.parallel_width, end = j + 1 == thrd_lim ? length : beg + ctx.parallel_width;
+		if (touch)
+			radix_first_touch(buffer + beg, end - beg);
+		count_all_duff_device<Trait>(first + beg, first + end, histogram[j]);
+		sync.arrive_and_wait();
+		parallel_msd_split<Trait::radix_size>(ctx, j);
+	});
+}
+
+//Sort on the workers of pool, using all of its threads
+template <typename Trait, typename Iter>
+void parallel_msd_radix_sort(Iter first, Iter second, radix_thread_pool& pool,
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	parallel_msd_radix_sort<Trait>(first, second, buffer, pool.size(), pool);
+}
+
+template <typename Iter>
+void parallel_msd_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr, 
+	unsigned int thrd_lim = std::thread::hardware_concurrency())
+{
+	parallel_msd_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer, thrd_lim);
+}
+
+template <typename Iter>
+void parallel_msd_radix_sort(Iter first, Iter second, radix_thread_pool& pool,
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	parallel_msd_radix_sort<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, pool, buffer);
+}
+
+// ----------------------------------------------
+// radix_string_trait: keys of runtime length. size(obj) is the length of the key in bytes and get(obj, depth) its
+// byte at depth < size(obj); a key that ends sorts before the longer keys it prefixes.
+// data(obj) is optional, it lets the comparisons of small buckets run on memcmp.
+// ----------------------------------------------
+template <typename T>
+struct radix_string_trait;
+
+template <>
+struct radix_string_trait<std::string_view>
+{
+	static std::size_t size(std::string_view obj) noexcept
+	{
+		return obj.size();
+	}
+	static uint8_t get(std::string_view obj, std::size_t depth) noexcept
+	{
+		return static_cast<uint8_t>(obj[depth]);
+	}
+	static const char* data(std::string_view obj) noexcept
+	{
+		return obj.data();
+	}
+};
+
+template <typename Alloc>
+struct radix_string_trait<std::basic_string<char, std::char_traits<char>, Alloc>> : radix_string_trait<std::string_view> {};
+
+//(pointer, length) keys, which need not be null terminated
+template <>
+struct radix_string_trait<std::pair<const char*, std::size_t>>
+{
+	static std::size_t size(const std::pair<const char*, std::size_t>& obj) noexcept
+	{
+		return obj.second;
+	}
+	static uint8_t get(const std::pair<const char*, std::size_t>& obj, std::size_t depth) noexcept
+	{
+		return static_cast<uint8_t>(obj.first[depth]);
+	}
+	static const char* data(const std::pair<const char*, std::size_t>& obj) noexcept
+	{
+		return obj.first;
+	}
+};
+
+//Order of two keys that share their first depth bytes
+template <typename Trait, typename T>
+bool radix_string_less(const T& a, const T& b, std::size_t depth) noexcept
+{
+	std::size_t na = Trait::size(a), nb = Trait::size(b), n = std::min(na, nb);
+	if constexpr (requires { Trait::data(a); })
+	{
+		if (n > depth)
+		{
+			int cmp = std::memcmp(Trait::data(a) + depth, Trait::data(b) + depth, n - depth);
+			if (cmp != 0)
+				return cmp < 0;
+		}
+	}
+	else
+	{
+		for (; depth < n; ++depth)
+		{
+			auto x = Trait::get(a, depth), y = Trait::get(b, depth);
+			if (x != y)
+				return x < y;
+		}
+	}
+	return na < nb;
+}
+
+//Stable insertion sort of keys that share their first depth bytes
+template <typename Trait, typename Iter>
+void radix_string_insertion_sort(Iter first, Iter second, std::size_t depth)
+{
+	if (first == second)
+		return;
+	for (auto cur = std::next(first); cur != second; ++cur)
+	{
+		if (!radix_string_less<Trait>(*cur, *std::prev(cur), depth))
+			continue;
+		auto obj = std::move(*cur);
+		auto pos = cur;
+		do
+		{
+			*pos = std::move(*std::prev(pos));
+			--pos;
+		} while (pos != first && radix_string_less<Trait>(obj, *std::prev(pos), depth));
+		*pos = std::move(obj);
+	}
+}
+
+//Stable MSD radix sort of variable-length keys. Bucket 0 holds the keys that end at the current depth, so it is done;
+//the other buckets go on a stack with the next depth, which keeps long shared prefixes off the call stack.
+//The digits of a pass are read once into a cache, and the elements ping-pong between the range and buffer.
+template <typename Trait, typename Iter>
+void string_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	using namespace std;
+	using T = typename iterator_traits<Iter>::value_type;
+	auto length = distance(first, second);
+	if (length <= msd_insertion_limit)
+		return radix_string_insertion_sort<Trait>(first, second, 0);
+	radix_scratch<T> resource;
+	if (buffer == nullptr)
+		buffer = resource.reserve(length);
+	struct task
+	{
+		std::ptrdiff_t beg, end;
+		std::size_t depth;
+		bool in_buffer;
+	};
+	vector<uint16_t> digit(length);
+	vector<task> stack{ { 0, length, 0, false } };
+	array<std::ptrdiff_t, 257> counter;
+	auto finish = [&](std::ptrdiff_t beg, std::ptrdiff_t end, bool in_buffer) {
+		if (in_buffer)
+			std::move(buffer + beg, buffer + end, first + beg);
+	};
+	auto distribute = [&](auto src, auto dst, const task& cur) {
+		counter.fill(0);
+		for (auto k = cur.beg; k < cur.end; ++k)
+		{
+			const T& obj = src[k];
+			auto d = cur.depth < Trait::size(obj) ? Trait::get(obj, cur.depth) + 1 : 0;
+			digit[k] = static_cast<uint16_t>(d);
+			++counter[d];
+		}
+		if (*max_element(counter.begin(), counter.end()) == cur.end - cur.beg)
+			return false;
+		std::ptrdiff_t sum = cur.beg;
+		for (auto& cnt : counter)
+		{
+			sum += cnt;
+			cnt = sum - cnt;
+		}
+		for (auto k = cur.beg; k < cur.end; ++k)
+			dst[counter[digit[k]]++] = std::move(src[k]);
+		return true;
+	};
+	while (!stack.empty())
+	{
+		task cur = stack.back();
+		stack.pop_back();
+		bool split = false;
+		while (true)
+		{
+			if (cur.end - cur.beg <= msd_insertion_limit)
+			{
+				finish(cur.beg, cur.end, cur.in_buffer);
+				radix_string_insertion_sort<Trait>(first + cur.beg, first + cur.end, cur.depth);
+				break;
+			}
+			split = cur.in_buffer ? distribute(buffer, first, cur) : distribute(first, buffer, cur);
+			if (split)
+				break;
+			//every key shares this byte, or every key has ended
+			if (digit[cur.beg] == 0)
+			{
+				finish(cur.beg, cur.end, cur.in_buffer);
+				break;
+			}
+			++cur.depth;
+		}
+		if (!split)
+			continue;
+		//the scatter leaves every counter at the end of its bucket
+		bool in_buffer = !cur.in_buffer;
+		finish(cur.beg, counter[0], in_buffer);
+		for (size_t k = 1; k < counter.size(); ++k)
+		{
+			auto beg = counter[k - 1], end = counter[k];
+			if (end - beg > 1)
+				stack.push_back({ beg, end, cur.depth + 1, in_buffer });
+			else
+				finish(beg, end, in_buffer);
+		}
+	}
+}
+
+template <typename Iter>
+void string_radix_sort(Iter first, Iter second, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	string_radix_sort<radix_string_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, buffer);
+}
+
+//Key and position of an element, sorted in place of the element itself
+template <typename K, typename Idx>
+struct radix_key_index
+{
+	K key;
+	Idx index;
+};
+
+//Digits of the key only: the stable sort keeps equal keys in index order
+template <typename KeyTrait, typename K, typename Idx>
+struct radix_trait_key_index
+{
+	static constexpr std::size_t radix_bits = radix_bits_v<KeyTrait>;
+	static constexpr std::size_t radix_size = KeyTrait::radix_size;
+
+	template <size_t index>
+	static auto get(const radix_key_index<K, Idx>& obj) noexcept
+	{
+		static_assert(index < radix_size, "index out of bounds");
+		return KeyTrait::template get<index>(obj.key);
+	}
+};
+
+//Sort key(*it) together with the position of every element, call fn with the sorted (key, index) pairs
+template <typename KeyTrait, typename Idx, typename Iter, typename KeyFn, typename Fn>
+void radix_sort_key_index(Iter first, Iter second, KeyFn& key, Fn&& fn)
+{
+	using K = std::remove_cvref_t<std::invoke_result_t<KeyFn&, const typename std::iterator_traits<Iter>::value_type&>>;
+	auto length = std::distance(first, second);
+	std::vector<radix_key_index<K, Idx>> keys(length);
+	Iter it = first;
+	for (std::ptrdiff_t j = 0; j < length; ++j, ++it)
+		keys[j] = { std::invoke(key, *it), static_cast<Idx>(j) };
+	radix_sort<radix_trait_key_index<KeyTrait, K, Idx>>(keys.begin(), keys.end());
+	fn(keys);
+}
+
+//Rearrange [first, second) so that the j-th element becomes the old element at index proj(index[j]).
+//Each element moves once into the buffer and once back.
+template <typename Iter, typename IndexIter, typename Proj = std::identity>
+void radix_permute(Iter first, Iter second, IndexIter index, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr, Proj proj = {})
+{
+	auto length = std::distance(first, second);
+	if (length <= 0)
+		return;
+	radix_scratch<typename std::iterator_traits<Iter>::value_type> resource;
+	if (buffer == nullptr)
+		buffer = resource.reserve(length);
+	for (std::ptrdiff_t j = 0; j < length; ++j, ++index)
+		buffer[j] = std::move(first[std::invoke(proj, *index)]);
+	std::move(buffer, buffer + length, first);
+}
+
+//Stable sort by key(element). Only compact (key, index) pairs go through the radix passes, and the elements are
+//gathered into the buffer in sorted order and moved back at the end, which pays off for large elements with small keys.
+template <typename KeyTrait, typename Iter, typename KeyFn>
+void radix_sort_by_key(Iter first, Iter second, KeyFn key, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	auto permute = [&](const auto& keys)
+	{
+		radix_permute(first, second, keys.begin(), buffer, [](const auto& k) { return k.index; });
+	};
+	if (std::distance(first, second) <= std::numeric_limits<uint32_t>::max())
+		radix_sort_key_index<KeyTrait, uint32_t>(first, second, key, permute);
+	else
+		radix_sort_key_index<KeyTrait, size_t>(first, second, key, permute);
+}
+
+template <typename Iter, typename KeyFn>
+void radix_sort_by_key(Iter first, Iter second, KeyFn key, 
+	typename std::iterator_traits<Iter>::value_type* buffer = nullptr)
+{
+	using K = std::remove_cvref_t<std::invoke_result_t<KeyFn&, const typename std::iterator_traits<Iter>::value_type&>>;
+	radix_sort_by_key<radix_trait<K>>(first, second, key, buffer);
+}
+
+//Indices that would stably sort [first, second) by key(element), the range itself is left untouched
+template <typename KeyTrait, typename Iter, typename KeyFn = std::identity>
+std::vector<size_t> radix_argsort(Iter first, Iter second, KeyFn key = {})
+{
+	std::vector<size_t> order;
+	auto collect = [&](const auto& keys)
+	{
+		order.reserve(keys.size());
+		for (const auto& k : keys)
+			order.push_back(k.index);
+	};
+	if (std::distance(first, second) <= std::numeric_limits<uint32_t>::max())
+		radix_sort_key_index<KeyTrait, uint32_t>(first, second, key, collect);
+	else
+		radix_sort_key_index<KeyTrait, size_t>(first, second, key, collect);
+	return order;
+}
+
+template <typename Iter, typename KeyFn = std::identity>
+std::vector<size_t> radix_argsort(Iter first, Iter second, KeyFn key = {})
+{
+	using K = std::remove_cvref_t<std::invoke_result_t<KeyFn&, const typename std::iterator_traits<Iter>::value_type&>>;
+	return radix_argsort<radix_trait<K>>(first, second, key);
+}
+
+// ----------------------------------------------
+// Sort with dedup or group-by-count: the range is partitioned on its top digit, then every bucket is sorted in cache
+// and its runs of equal elements are collapsed while it is still there, on the way back to the range.
+// Elements are equal when all of their digits under Trait are, the first of every run is kept.
+// ----------------------------------------------
+constexpr std::size_t radix_fused_bytes = std::size_t(1) << 19; //bucket size sorted in cache, smaller inputs are sorted whole
+constexpr std::size_t radix_fused_buckets = 4096; //most buckets of a partition, more would miss the TLB on every store
+
+template <typename Trait, typename T>
+bool radix_equal(const T& a, const T& b) noexcept
+{
+	if constexpr (std::is_integral_v<T> && std::is_same_v<Trait, radix_trait<T>>)
+		return a == b;
+	else
+		return [&]<size_t... i>(std::index_sequence<i...>) {
+			return ((Trait::template get<i>(a) == Trait::template get<i>(b)) && ...);
+		}(std::make_index_sequence<Trait::radix_size>());
+}
+
+//Move the first of every run of equal elements of the sorted [first, second) to dst, which may be first or lie before it,
+//and append the length of every run to counts when it is given
+template <typename Trait, typename Iter, typename OutIter>
+OutIter radix_unique_move(Iter first, Iter second, OutIter dst, std::vector<size_t>* counts)
+{
+	while (first != second)
+	{
+		auto next = std::next(first);
+		while (next != second && radix_equal<Trait>(*first, *next))
+			++next;
+		if (counts != nullptr)
+			counts->push_back(static_cast<size_t>(std::distance(first, next)));
+		if constexpr (std::is_same_v<Iter, OutIter>)
+		{
+			if (dst != first)
+				*dst = std::move(*first);
+		}
+		else
+			*dst = std::move(*first);
+		++dst;
+		first = next;
+	}
+	return dst;
+}
+
+//Call fn(std::integral_constant<size_t, i>()) for the digit i chosen at run time
+template <typename Trait, typename Fn>
+void radix_with_digit(size_t i, Fn&& fn)
+{
+	[&]<size_t... k>(std::index_sequence<k...>) {
+		(void)((k == i ? (fn(std::integral_constant<size_t, k>()), true) : false) || ...);
+	}(std::make_index_sequence<Trait::radix_size>());
+}
+
+//Run job(j) for every j in [0, thrd_lim), on pool unless there is a single thread, which needs no pool
+template <typename Job>
+void radix_run_jobs(radix_thread_pool* pool, unsigned int thrd_lim, Job&& job)
+{
+	if (thrd_lim <= 1)
+		job(0u);
+	else
+		pool->run(thrd_lim, job);
+}
+
+//Partition the slices of the threads stably on digit top, and digit top - 1 below it when two is set, then sort and
+//collapse the buckets that start in each thread's share of the output. One thread writes them straight back,
+//more threads collapse them in the scratch buffer first and move them back once their offsets are known.
+template <typename Trait, size_t top, bool two, typename Iter>
+Iter radix_unique_buckets(Iter first, Iter second, const std::vector<radix_histogram<Trait, std::ptrdiff_t>>& histogram,
+	std::vector<size_t>* counts, unsigned int thrd_lim, radix_thread_pool* pool)
+{
+	using namespace std;
+	using T = typename iterator_traits<Iter>::value_type;
+	constexpr size_t bucket_cnt = two ? radix_count_v<Trait> * radix_count_v<Trait> : radix_count_v<Trait>;
+	auto bucket = [](const T& obj) {
+		size_t b = Trait::template get<top>(obj);
+		if constexpr (two)
+			b = b << radix_bits_v<Trait> | Trait::template get<top - 1>(obj);
+		return b;
+	};
+	auto length = distance(first, second);
+	auto slice = [&](unsigned int j) {
+		return pair{ first + ptrdiff_t(length * j / thrd_lim), first + ptrdiff_t(length * (j + 1) / thrd_lim) };
+	};
+	radix_workspace<T, Trait> scratch;
+	T* buffer = scratch.buffer(length);
+
+	vector<ptrdiff_t> position(size_t(thrd_lim) * bucket_cnt);
+	if constexpr (two)
+		radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+			auto [beg, end] = slice(j);
+			auto cnt = position.data() + size_t(j) * bucket_cnt;
+			for (auto it = beg; it != end; ++it)
+				++cnt[bucket(*it)];
+		});
+	else
+		for (auto j = 0u; j < thrd_lim; ++j)
+			copy(histogram[j][top].begin(), histogram[j][top].end(), position.begin() + ptrdiff_t(j * bucket_cnt));
+	vector<ptrdiff_t> start(bucket_cnt + 1);
+	for (size_t d = 0; d < bucket_cnt; ++d)
+	{
+		start[d + 1] = start[d];
+		for (auto j = 0u; j < thrd_lim; ++j)
+			start[d + 1] += exchange(position[size_t(j) * bucket_cnt + d], start[d + 1]);
+	}
+	radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+		auto [beg, end] = slice(j);
+		auto pos = position.data() + size_t(j) * bucket_cnt;
+		for (auto it = beg; it != end; ++it)
+			buffer[pos[bucket(*it)]++] = std::move(*it);
+	});
+
+	//first bucket of every thread
+	vector<size_t> bucket_beg(thrd_lim + 1, bucket_cnt);
+	for (size_t d = bucket_cnt; d-- > 0;)
+		bucket_beg[min<size_t>(thrd_lim - 1, size_t(start[d]) * thrd_lim / size_t(length))] = d;
+	for (auto j = thrd_lim; j-- > 0;)
+		bucket_beg[j] = min(bucket_beg[j], bucket_beg[j + 1]);
+	vector<ptrdiff_t> distinct(thrd_lim + 1);
+	vector<vector<size_t>> thread_counts(counts != nullptr && thrd_lim > 1 ? thrd_lim : 0);
+	radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+		radix_workspace<T, Trait> workspace;
+		//the counts grow with the distinct keys, reserving one per element would cost a word per input element
+		auto thread_count = thread_counts.empty() ? counts : &thread_counts[j];
+		T* dst = buffer + start[bucket_beg[j]];
+		auto out = first;
+		for (auto d = bucket_beg[j]; d < bucket_beg[j + 1]; ++d)
+		{
+			T* beg = buffer + start[d];
+			T* end = buffer + start[d + 1];
+			radix_sort_run<Trait>(beg, end, nullptr, workspace);
+			if (thrd_lim <= 1)
+				out = radix_unique_move<Trait>(beg, end, out, thread_count);
+			else
+				dst = radix_unique_move<Trait>(beg, end, dst, thread_count);
+		}
+		distinct[j + 1] = thrd_lim <= 1 ? distance(first, out) : dst - (buffer + start[bucket_beg[j]]);
+	});
+	if (thrd_lim <= 1)
+		return first + distinct[1];
+
+	for (auto j = 0u; j < thrd_lim; ++j)
+		distinct[j + 1] += distinct[j];
+	if (counts != nullptr)
+		counts->resize(size_t(distinct[thrd_lim]));
+	radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+		T* src = buffer + start[bucket_beg[j]];
+		move(src, src + (distinct[j + 1] - distinct[j]), first + distinct[j]);
+		if (counts != nullptr)
+			copy(thread_counts[j].begin(), thread_counts[j].end(), counts->begin() + distinct[j]);
+	});
+	return first + distinct[thrd_lim];
+}
+
+template <typename Trait, typename Iter>
+Iter radix_sort_unique_run(Iter first, Iter second, std::vector<size_t>* counts, unsigned int thrd_lim, radix_thread_pool* pool)
+{
+	using namespace std;
+	using T = typename iterator_traits<Iter>::value_type;
+	auto length = distance(first, second);
+	if (counts != nullptr)
+		counts->clear();
+	//0 threads, as hardware_concurrency() may report, runs on one like parallel_radix_sort
+	thrd_lim = max(1u, parallel_thread_limit<T>(length, thrd_lim));
+	if (thrd_lim <= 1 && size_t(length) * sizeof(T) <= radix_fused_bytes)
+	{
+		radix_workspace<T, Trait> workspace;
+		radix_sort_run<Trait>(first, second, nullptr, workspace);
+		return radix_unique_move<Trait>(first, second, first, counts);
+	}
+
+	//the partition takes the highest digit that is not trivial, with the one below it when its few values alone
+	//leave buckets larger than the cache
+	vector<radix_histogram<Trait, ptrdiff_t>> histogram(thrd_lim);
+	radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+		count_all_duff_device<Trait>(first + ptrdiff_t(length * j / thrd_lim), first + ptrdiff_t(length * (j + 1) / thrd_lim), histogram[j]);
+	});
+	size_t top = Trait::radix_size, values = 0;
+	while (top-- > 0)
+	{
+		values = 0;
+		for (size_t k = 0; k < radix_count_v<Trait>; ++k)
+		{
+			ptrdiff_t cnt = 0;
+			for (auto& h : histogram)
+				cnt += h[top][k];
+			values += cnt != 0;
+		}
+		if (values > 1)
+			break;
+	}
+	if (values <= 1)
+	{
+		//every element is equal
+		if (counts != nullptr)
+			counts->push_back(size_t(length));
+		return next(first);
+	}
+	Iter ret = first;
+	radix_with_digit<Trait>(top, [&]<size_t i>(integral_constant<size_t, i>) {
+		if constexpr (i > 0 && radix_bits_v<Trait> <= 8)
+			if (size_t(length) / values * sizeof(T) > radix_fused_bytes && values * radix_count_v<Trait> <= radix_fused_buckets)
+				return void(ret = radix_unique_buckets<Trait, i, true>(first, second, histogram, counts, thrd_lim, pool));
+		ret = radix_unique_buckets<Trait, i, false>(first, second, histogram, counts, thrd_lim, pool);
+	});
+	return ret;
+}
+
+//Sort [first, second) and keep the first of every run of equal elements, as std::unique does after a sort, in
+//[first, ret). The elements past ret are left in a valid but unspecified state.
+template <typename Trait, typename Iter>
+Iter radix_sort_unique(Iter first, Iter second)
+{
+	return radix_sort_unique_run<Trait>(first, second, nullptr, 1, nullptr);
+}
+
+template <typename Iter>
+Iter radix_sort_unique(Iter first, Iter second)
+{
+	return radix_sort_unique<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second);
+}
+
+//Same as radix_sort_unique, and counts[k] is the number of elements equal to first[k], counts holds one per distinct element
+template <typename Trait, typename Iter>
+Iter radix_sort_count(Iter first, Iter second, std::vector<size_t>& counts)
+{
+	return radix_sort_unique_run<Trait>(first, second, &counts, 1, nullptr);
+}
+
+template <typename Iter>
+Iter radix_sort_count(Iter first, Iter second, std::vector<size_t>& counts)
+{
+	return radix_sort_count<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, counts);
+}
+
+template <typename Trait, typename Iter>
+Iter parallel_radix_sort_unique(Iter first, Iter second, unsigned int thrd_lim = std::thread::hardware_concurrency(),
+	radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	return radix_sort_unique_run<Trait>(first, second, nullptr, thrd_lim, &pool);
+}
+
+template <typename Iter>
+Iter parallel_radix_sort_unique(Iter first, Iter second, unsigned int thrd_lim = std::thread::hardware_concurrency())
+{
+	return parallel_radix_sort_unique<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, thrd_lim);
+}
+
+template <typename Trait, typename Iter>
+Iter parallel_radix_sort_count(Iter first, Iter second, std::vector<size_t>& counts,
+	unsigned int thrd_lim = std::thread::hardware_concurrency(), radix_thread_pool& pool = radix_thread_pool::default_pool())
+{
+	return radix_sort_unique_run<Trait>(first, second, &counts, thrd_lim, &pool);
+}
+
+template <typename Iter>
+Iter parallel_radix_sort_count(Iter first, Iter second, std::vector<size_t>& counts,
+	unsigned int thrd_lim = std::thread::hardware_concurrency())
+{
+	return parallel_radix_sort_count<radix_trait<typename std::iterator_traits<Iter>::value_type>>(first, second, counts, thrd_lim);
+}
+
+// ----------------------------------------------
+// Columnar sort: key and payload columns kept in separate vectors
+// ----------------------------------------------
+//A key column of a columnar sort and the trait giving its order
+template <typename T, typename Trait = radix_trait<T>>
+struct radix_key_column
+{
+	using value_type = T;
+	using trait = Trait;
+	std::vector<T>& column;
+};
+
+template <typename T>
+radix_key_column<T> radix_ascending(std::vector<T>& column)
+{
+	return { column };
+}
+
+template <typename T>
+radix_key_column<T, radix_trait_reverse<radix_trait<T>>> radix_descending(std::vector<T>& column)
+{
+	return { column };
+}
+
+//Key columns of a columnar sort, the first one the most significant
+template <typename... KeyT, typename... KeyTrait>
+std::tuple<radix_key_column<KeyT, KeyTrait>...> radix_keys(radix_key_column<KeyT, KeyTrait>... keys)
+{
+	return { keys... };
+}
+
+constexpr std::size_t radix_column_block = 8192; //rows gathered from every column before the next block
+
+//Run fn(beg, end) over [0, length) split between thrd_lim threads of the default pool
+template <typename Fn>
+void radix_for_ranges(std::size_t length, unsigned int thrd_lim, Fn&& fn)
+{
+	if (thrd_lim <= 1)
+		return fn(std::size_t(0), length);
+	radix_thread_pool::default_pool().run(thrd_lim, [&](unsigned int j) {
+		fn(length * j / thrd_lim, length * (j + 1) / thrd_lim);
+	});
+}
+
+template <typename Idx, typename... KeyT, typename... KeyTrait, typename... Payload>
+void radix_sort_columns_run(unsigned int thrd_lim, std::tuple<radix_key_column<KeyT, KeyTrait>...> keys, std::vector<Payload>&... payload)
+{
+	using namespace std;
+	using Key = tuple<KeyT...>;
+	using Row = radix_key_index<Key, Idx>;
+	using RowTrait = radix_trait_key_index<radix_trait_columns<KeyTrait...>, Key, Idx>;
+	auto length = get<0>(keys).column.size();
+	auto key_columns = make_index_sequence<sizeof...(KeyT)>();
+
+	vector<Row> rows(length);
+	radix_for_ranges(length, thrd_lim, [&](size_t beg, size_t end) {
+		[&]<size_t... c>(index_sequence<c...>) {
+			for (size_t j = beg; j < end; ++j)
+				rows[j] = { Key(get<c>(keys).column[j]...), static_cast<Idx>(j) };
+		}(key_columns);
+	});
+	if (thrd_lim > 1)
+		parallel_radix_sort<RowTrait>(rows.begin(), rows.end(), nullptr, thrd_lim);
+	else
+		radix_sort<RowTrait>(rows.begin(), rows.end());
+
+	//the keys come back from the rows, the payload through the order
+	vector<Idx> order(sizeof...(Payload) != 0 ? length : 0);
+	radix_for_ranges(length, thrd_lim, [&](size_t beg, size_t end) {
+		[&]<size_t... c>(index_sequence<c...>) {
+			for (size_t j = beg; j < end; ++j)
+			{
+				((get<c>(keys).column[j] = get<c>(rows[j].key)), ...);
+				if constexpr (sizeof...(Payload) != 0)
+					order[j] = rows[j].index;
+			}
+		}(key_columns);
+	});
+	if constexpr (sizeof...(Payload) != 0)
+	{
+		vector<Row>().swap(rows);
+		tuple<vector<Payload>...> sorted{ vector<Payload>(length)... };
+		radix_for_ranges(length, thrd_lim, [&](size_t beg, size_t end) {
+			for (size_t b = beg; b < end; b += radix_column_block)
+			{
+				auto e = min(end, b + radix_column_block);
+				[&]<size_t... c>(index_sequence<c...>) {
+					auto gather = [&](auto& to, auto& from) {
+						for (size_t j = b; j < e; ++j)
+							to[j] = std::move(from[order[j]]);
+					};
+					(gather(get<c>(sorted), payload), ...);
+				}(make_index_sequence<sizeof...(Payload)>());
+			}
+		});
+		[&]<size_t... c>(index_sequence<c...>) {
+			(payload.swap(get<c>(sorted)), ...);
+		}(make_index_sequence<sizeof...(Payload)>());
+	}
+}
+
+//Stable sort of the rows of a columnar table by its key columns, the first one the most significant, moving every
+//payload column along. The keys are sorted as compact (keys, row) records, the payload is gathered once per column,
+//in blocks of rows shared by all columns. Every column must have as many rows as the first key column.
+template <typename ExecutionPolicy, typename... KeyT, typename... KeyTrait, typename... Payload>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_columns(ExecutionPolicy&&, std::tuple<radix_key_column<KeyT, KeyTrait>...> keys, std::vector<Payload>&... payload)
+{
+	using namespace std;
+	static_assert(sizeof...(KeyT) != 0, "radix_sort_columns needs a key column");
+	auto length = get<0>(keys).column.size();
+	bool same = apply([&](auto&... key) { return ((key.column.size() == length) && ...); }, keys) && ((payload.size() == length) && ...);
+	if (!same)
+		throw invalid_argument("radix_sort_columns: columns of different lengths");
+	unsigned int thrd_lim = 1;
+	if constexpr (is_same_v<remove_cvref_t<ExecutionPolicy>, execution::parallel_policy> ||
+		is_same_v<remove_cvref_t<ExecutionPolicy>, execution::parallel_unsequenced_policy>)
+		thrd_lim = parallel_thread_limit<radix_key_index<tuple<KeyT...>, size_t>>(length, thread::hardware_concurrency());
+	if (length <= numeric_limits<uint32_t>::max())
+		radix_sort_columns_run<uint32_t>(thrd_lim, keys, payload...);
+	else
+		radix_sort_columns_run<size_t>(thrd_lim, keys, payload...);
+}
+
+template <typename... KeyT, typename... KeyTrait, typename... Payload>
+void radix_sort_columns(std::tuple<radix_key_column<KeyT, KeyTrait>...> keys, std::vector<Payload>&... payload)
+{
+	radix_sort_columns(std::execution::seq, keys, payload...);
+}
+
+//Sort by a single key column
+template <typename K, typename KeyTrait, typename... Payload>
+void radix_sort_columns(radix_key_column<K, KeyTrait> key, std::vector<Payload>&... payload)
+{
+	radix_sort_columns(std::make_tuple(key), payload...);
+}
+
+template <typename ExecutionPolicy, typename K, typename KeyTrait, typename... Payload>
+	requires std::is_execution_policy_v<std::remove_cvref_t<ExecutionPolicy>>
+void radix_sort_columns(ExecutionPolicy&& policy, radix_key_column<K, KeyTrait> key, std::vector<Payload>&... payload)
+{
+	radix_sort_columns(std::forward<ExecutionPolicy>(policy), std::make_tuple(key), payload...);
+}
+
+//Stateful sorter for repeated batches: it keeps its scratch buffer, counters and thread pool between calls,
+//so sorting batches no larger than the ones before does not allocate.
+template <typename T, typename Trait = radix_trait<T>>
+class radix_sorter
+{
+public:
+	//parallel sorts run on the default pool, which starts with the first of them
+	radix_sorter() = default;
+
+	//parallel sorts run on a pool of thrd_cnt threads owned by the sorter
+	explicit radix_sorter(unsigned int thrd_cnt, radix_affinity affinity = radix_affinity::none)
+		: own_pool(std::make_unique<radix_thread_pool>(thrd_cnt, affinity)), pool(own_pool.get()) {}
+
+	//parallel sorts run on the caller's pool, which must outlive the sorter
+	explicit radix_sorter(radix_thread_pool& pool) : pool(&pool) {}
+
+	//Preallocate for batches of up to length elements sorted by up to thrd_lim threads
+	void reserve(size_t length, unsigned int thrd_lim = 1)
+	{
+		workspace.buffer(length);
+		workspace.template histogram<int>();
+		thrd_lim = parallel_thread_limit<T>(length, thrd_lim);
+		if (thrd_lim > 1)
+			workspace.reserve_threads(thrd_lim);
+	}
+
+	template <typename Iter>
+	void sort(Iter first, Iter second)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		radix_sort_run<Trait>(first, second, nullptr, workspace);
+	}
+
+	template <typename Iter>
+	void parallel_sort(Iter first, Iter second)
+	{
+		parallel_sort(first, second, thread_pool().size());
+	}
+
+	template <typename Iter>
+	void parallel_sort(Iter first, Iter second, unsigned int thrd_lim)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		parallel_radix_sort_run<Trait>(first, second, nullptr, thrd_lim, thread_pool(), workspace);
+	}
+
+	//Sorts recording per-pass statistics into stats (see radix_sort_stats)
+	template <typename Iter, radix_stats_observer Stats>
+	void sort(Iter first, Iter second, Stats& stats)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		radix_sort_run<Trait>(first, second, nullptr, workspace, &stats);
+	}
+
+	template <typename Iter, radix_stats_observer Stats>
+	void parallel_sort(Iter first, Iter second, Stats& stats)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		auto& workers = thread_pool();
+		parallel_radix_sort_run<Trait>(first, second, nullptr, workers.size(), workers, workspace, &stats);
+	}
+
+	template <typename Iter, typename ExecutionPolicy>
+	void sort(Iter first, Iter second, ExecutionPolicy&& policy)
+	{
+		(void)policy;
+		if constexpr (std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_policy> || \
+			std::is_same_v<std::remove_cvref_t<ExecutionPolicy>, std::execution::parallel_unsequenced_policy>)
+			parallel_sort(first, second);
+		else
+			sort(first, second);
+	}
+
+	radix_thread_pool& thread_pool() const
+	{
+		return pool != nullptr ? *pool : radix_thread_pool::default_pool();
+	}
+
+	//Stable MSD sort on the sorter's scratch buffer, see msd_radix_sort
+	template <typename Iter>
+	void msd_sort(Iter first, Iter second)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		msd_radix_sort<Trait>(first, second, workspace.buffer(std::distance(first, second)));
+	}
+
+	//Segmented sort on the sorter's scratch buffer, see segmented_radix_sort
+	template <typename Iter, typename OffsetIter>
+	void segmented_sort(Iter first, Iter second, OffsetIter offsets_first, OffsetIter offsets_second)
+	{
+		static_assert(std::is_same_v<typename std::iterator_traits<Iter>::value_type, T>, "radix_sorter<T> sorts ranges of T");
+		radix_segment_bounds(offsets_first, offsets_second, std::distance(first, second), segment_bounds);
+		if (!segment_bounds.empty())
+			radix_sort_segments<Trait>(first, segment_bounds.data(), segment_bounds.size() - 1, workspace);
+	}
+
+	//Choose how passes store elements into their buckets, automatic by default
+	void set_scatter(radix_scatter scatter) noexcept
+	{
+		workspace.scatter = scatter;
+	}
+
+private:
+	radix_workspace<T, Trait> workspace;
+	std::vector<std::ptrdiff_t> segment_bounds;
+	std::unique_ptr<radix_thread_pool> own_pool;
+	radix_thread_pool* pool = nullptr;	//the default pool
+};
+
+// ----------------------------------------------
+// Incremental sort of a range that arrives in chunks
+// Chunks are gathered into runs that background threads partition on the upper bits of their keys as soon as they are
+// full, the pass over main memory that overlaps with producing the input. finish() then sorts each bucket, gathered from
+// the runs, in cache.
+// ----------------------------------------------
+template <typename T>
+struct radix_incremental_run
+{
+	std::vector<T> data;
+	std::vector<size_t> bounds; //start of every bucket of the batch window in the partitioned data, then its end
+};
+
+//The digits of Trait that fit 64 bits from the most significant one, as an unsigned integer of the same order
+template <typename Trait, typename T>
+uint64_t radix_key_prefix(const T& obj) noexcept
+{
+	constexpr size_t digits = std::min<size_t>(Trait::radix_size, 64 / radix_bits_v<Trait>);
+	return [&]<size_t... k>(std::index_sequence<k...>) {
+		uint64_t prefix = 0;
+		((prefix = prefix << radix_bits_v<Trait> | Trait::template get<Trait::radix_size - 1 - k>(obj)), ...);
+		return prefix;
+	}(std::make_index_sequence<digits>());
+}
+
+//Up to radix_fused_buckets buckets over the key prefixes of a range. IDs and timestamps keep their upper bytes, so a
+//fixed top digit would leave them in one bucket. Keys outside the range go to the first or last bucket, which keeps the
+//buckets in key order for keys that stray from it, e.g. timestamps that keep rising.
+template <typename Trait>
+struct radix_key_window
+{
+	uint64_t base = 0;
+	int shift = 0;
+	size_t bucket_cnt = 1;
+
+	template <typename Iter>
+	void span(Iter first, Iter second)
+	{
+		using T = typename std::iterator_traits<Iter>::value_type;
+		if (first == second)
+			return;
+		auto [lo, hi] = std::minmax_element(first, second, [](const T& a, const T& b) {
+			return radix_key_prefix<Trait>(a) < radix_key_prefix<Trait>(b);
+		});
+		base = radix_key_prefix<Trait>(*lo);
+		auto width = radix_key_prefix<Trait>(*hi) - base;
+		shift = std::max(0, int(std::bit_width(width)) - std::countr_zero(radix_fused_buckets));
+		bucket_cnt = size_t(width >> shift) + 1;
+	}
+
+	template <typename T>
+	uint16_t bucket(const T& obj) const noexcept
+	{
+		auto prefix = radix_key_prefix<Trait>(obj);
+		return static_cast<uint16_t>(prefix <= base ? 0 : std::min<uint64_t>((prefix - base) >> shift, bucket_cnt - 1));
+	}
+};
+
+//Stable partition of [first, second) on window into dst, bounds receives the start of every bucket, then the end
+template <typename Trait, typename Iter, typename T>
+void radix_window_partition(Iter first, Iter second, T* dst, const radix_key_window<Trait>& window,
+	std::vector<size_t>& bounds, std::vector<size_t>& next, std::vector<uint16_t>& bucket)
+{
+	auto length = size_t(std::distance(first, second));
+	bounds.assign(window.bucket_cnt + 1, 0);
+	bucket.resize(length);
+	auto it = first;
+	for (size_t k = 0; k < length; ++k, ++it)
+		++bounds[(bucket[k] = window.bucket(*it)) + 1];
+	for (size_t d = 0; d < window.bucket_cnt; ++d)
+		bounds[d + 1] += bounds[d];
+	next.assign(bounds.begin(), bounds.end() - 1);
+	it = first;
+	for (size_t k = 0; k < length; ++k, ++it)
+		dst[next[bucket[k]]++] = std::move(*it);
+}
+
+//The runs of one finish(), shared by the threads still partitioning them and the final sort
+template <typename T, typename Trait>
+struct radix_incremental_batch
+{
+	std::deque<radix_incremental_run<T>> runs;
+	radix_key_window<Trait> window;	//set by the first run partitioned
+	std::once_flag window_chosen;
+	size_t sorting = 0;
+	std::exception_ptr error;
+	std::mutex mtx;
+	std::condition_variable sorted;
+};
+
+//Stable partition of a run on the window of batch into scratch, which is swapped in
+template <typename T, typename Trait>
+void radix_partition_run(radix_incremental_batch<T, Trait>& batch, radix_incremental_run<T>& run, std::vector<T>& scratch,
+	std::vector<size_t>& next, std::vector<uint16_t>& bucket)
+{
+	std::call_once(batch.window_chosen, [&] { batch.window.span(run.data.begin(), run.data.end()); });
+	scratch.resize(run.data.size());
+	radix_window_partition(run.data.begin(), run.data.end(), scratch.data(), batch.window, run.bounds, next, bucket);
+	std::swap(run.data, scratch);
+}
+
+//Sort a bucket that outgrew the cache: split it again on a window of its own keys and sort the parts in cache, on up to
+//thrd_lim threads of pool, each taking the parts that start in its share
+template <typename Trait, typename T>
+void radix_sort_split(T* first, T* second, unsigned int thrd_lim, radix_thread_pool* pool)
+{
+	using namespace std;
+	auto length = size_t(second - first);
+	radix_key_window<Trait> window;
+	window.span(first, second);
+	vector<T> scratch(window.bucket_cnt > 1 ? length : 0);
+	vector<size_t> bounds{ 0, length }, next;
+	vector<uint16_t> bucket;
+	if (window.bucket_cnt > 1)
+		radix_window_partition(first, second, scratch.data(), window, bounds, next, bucket);
+	radix_run_jobs(pool, thrd_lim, [&](unsigned int j) {
+		radix_sorter<T, Trait> sorter;
+		for (size_t d = 0; d + 1 < bounds.size(); ++d)
+		{
+			if (bounds[d] == bounds[d + 1] || min<size_t>(thrd_lim - 1, bounds[d] * thrd_lim / length) != j)
+				continue;
+			if (window.bucket_cnt <= 1)
+				return sorter.sort(first, second);
+			sorter.sort(scratch.begin() + ptrdiff_t(bounds[d]), scratch.begin() + ptrdiff_t(bounds[d + 1]));
+			move(scratch.begin() + ptrdiff_t(bounds[d]), scratch.begin() + ptrdiff_t(bounds[d + 1]), first + bounds[d]);
+		}
+	});
+}
+
+//Wait for the runs of batch to be partitioned, then gather every bucket of the window from the runs in push order
+//and sort it, on up to thrd_lim threads. The buckets are sorted in cache, unlike the whole range: keys outside the
+//window or crowded in part of it leave larger buckets, which are split again, by all the threads once the others are
+//sorted when they outgrow a thread's share.
+template <typename T, typename Trait>
+std::vector<T> radix_sort_runs(radix_incremental_batch<T, Trait>& batch, unsigned int thrd_lim)
+{
+	using namespace std;
+	{
+		unique_lock<mutex> lock(batch.mtx);
+		batch.sorted.wait(lock, [&batch] { return batch.sorting == 0; });
+	}
+	if (batch.error)
+		rethrow_exception(batch.error);
+	auto& runs = batch.runs;
+	if (runs.empty())
+		return {};
+
+	auto bucket_cnt = batch.window.bucket_cnt;
+	vector<size_t> start(bucket_cnt + 1);
+	for (auto& run : runs)
+		for (size_t d = 0; d < bucket_cnt; ++d)
+			start[d + 1] += run.bounds[d + 1] - run.bounds[d];
+	for (size_t d = 0; d < bucket_cnt; ++d)
+		start[d + 1] += start[d];
+	auto length = start.back();
+	vector<T> sorted(length);
+	thrd_lim = static_cast<unsigned int>(clamp<size_t>(length / size_t(radix_host_tuning().template thread_length<T>()), 1, thrd_lim));
+
+	//each thread takes the buckets that start in its share of the output
+	auto share = length / thrd_lim + 1;
+	auto job = [&](unsigned int j) {
+		radix_sorter<T, Trait> sorter;
+		for (size_t d = 0; d < bucket_cnt; ++d)
+		{
+			if (start[d] == start[d + 1] || min<size_t>(thrd_lim - 1, start[d] * thrd_lim / length) != j)
+				continue;
+			auto out = sorted.data() + start[d];
+			for (auto& run : runs)
+				out = move(run.data.begin() + ptrdiff_t(run.bounds[d]), run.data.begin() + ptrdiff_t(run.bounds[d + 1]), out);
+			auto size = start[d + 1] - start[d];
+			if (Trait::radix_size <= 1 || size > share)
+				continue;
+			if (size * sizeof(T) > radix_fused_bytes)
+				radix_sort_split<Trait>(sorted.data() + start[d], out, 1, nullptr);
+			else
+				sorter.sort(sorted.data() + start[d], out);
+		}
+	};
+	if (thrd_lim <= 1)
+	{
+		job(0);
+		return sorted;
+	}
+	auto& pool = radix_thread_pool::default_pool();
+	pool.run(thrd_lim, job);
+	if constexpr (Trait::radix_size > 1)
+		for (size_t d = 0; d < bucket_cnt; ++d)
+			if (start[d + 1] - start[d] > share)
+				radix_sort_split<Trait>(sorted.data() + start[d], sorted.data() + start[d + 1], thrd_lim, &pool);
+	return sorted;
 }
 
+//Sorts a range pushed in chunks, e.g. by a decoder, while it is still arriving.
+//Chunks are gathered into runs of at least run_length elements, each full run is partitioned on the upper bits of its keys
+//by one of thrd_cnt background threads, and finish() sorts the buckets into a vector in the background, on up to thrd_cnt
+//threads. The sort is stable in push order and holds the data twice while it finishes.
+//push and finish are called by one thread at a time, the sorter takes the next batch of chunks right after finish.
+template <typename T, typename Trait = radix_trait<T>>
+class radix_incremental_sorter
+{
+public:
+	explicit radix_incremental_sorter(unsigned int thrd_cnt = 1, size_t run_length = size_t(1) << 18)
+		: run_length(std::max<size_t>(run_length, 1)), thrd_cnt(std::max(thrd_cnt, 1u))
+	{
+		workers.reserve(this->thrd_cnt);
+		for (auto j = 0u; j < this->thrd_cnt; ++j)
+			workers.emplace_back(&radix_incremental_sorter::work, this);
+	}
+
+	//Runs pushed but not finished are still partitioned, then dropped
+	~radix_incremental_sorter()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			stopping = true;
+		}
+		work_cv.notify_all();
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	radix_incremental_sorter(const radix_incremental_sorter&) = delete;
+	radix_incremental_sorter& operator=(const radix_incremental_sorter&) = delete;
+
+	template <typename Iter>
+	void push(Iter first, Iter second)
+	{
+		pending.insert(pending.end(), first, second);
+		if (pending.size() >= run_length)
+			submit(std::exchange(pending, std::vector<T>()));
+	}
+
+	//A chunk of at least run_length elements becomes a run without a copy
+	void push(std::vector<T>&& chunk)
+	{
+		if (pending.empty() && chunk.size() >= run_length)
+			submit(std::move(chunk));
+		else
+			push(std::make_move_iterator(chunk.begin()), std::make_move_iterator(chunk.end()));
+	}
+
+	//The elements pushed since the last finish, sorted. The future rethrows the exceptions of their sort.
+	std::future<std::vector<T>> finish()
+	{
+		return std::async(std::launch::async, [batch = close_batch(), thrd_lim = thrd_cnt] {
+			return radix_sort_runs(*batch, thrd_lim);
+		});
+	}
+
+	//Call done(std::vector<T>&&) with the elements pushed since the last finish, sorted, on a background thread.
+	//The exceptions of an earlier sort or done are rethrown by the next finish(done) or by wait().
+	template <typename Callback>
+	void finish(Callback done)
+	{
+		for (auto it = callbacks.begin(); it != callbacks.end();)
+		{
+			if (it->wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++it;
+				continue;
+			}
+			auto callback = std::move(*it);
+			it = callbacks.erase(it);
+			callback.get();
+		}
+		callbacks.push_back(std::async(std::launch::async, [batch = close_batch(), thrd_lim = thrd_cnt, done = std::move(done)]() mutable {
+			done(radix_sort_runs(*batch, thrd_lim));
+		}));
+	}
+
+	//Wait for the callbacks of finish(done)
+	void wait()
+	{
+		auto running = std::exchange(callbacks, std::vector<std::future<void>>());
+		for (auto& callback : running)
+			callback.get();
+	}
+
+private:
+	using batch_type = radix_incremental_batch<T, Trait>;
+
+	void submit(std::vector<T>&& data)
+	{
+		{
+			std::lock_guard<std::mutex> batch_lock(batch->mtx);
+			++batch->sorting;
+		}
+		batch->runs.push_back({ std::move(data), {} });
+		{
+			std::lock_guard<std::mutex> lock(mtx);
+			jobs.emplace_back(batch, &batch->runs.back());
+		}
+		work_cv.notify_one();
+	}
+
+	std::shared_ptr<batch_type> close_batch()
+	{
+		if (!pending.empty())
+			submit(std::exchange(pending, std::vector<T>()));
+		return std::exchange(batch, std::make_shared<batch_type>());
+	}
+
+	void work()
+	{
+		std::vector<T> scratch;
+		std::vector<size_t> next;
+		std::vector<uint16_t> bucket;
+		for (;;)
+		{
+			std::pair<std::shared_ptr<batch_type>, radix_incremental_run<T>*> job;
+			{
+				std::unique_lock<std::mutex> lock(mtx);
+				work_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (jobs.empty())
+					return;
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			auto& [owner, run] = job;
+			std::exception_ptr error;
+			try
+			{
+				radix_partition_run(*owner, *run, scratch, next, bucket);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			{
+				std::lock_guard<std::mutex> batch_lock(owner->mtx);
+				if (error && !owner->error)
+					owner->error = error;
+				--owner->sorting;
+			}
+			owner->sorted.notify_all();
+		}
+	}
+
+	size_t run_length;
+	unsigned int thrd_cnt;
+	std::vector<T> pending; //chunks of the run being gathered
+	std::shared_ptr<batch_type> batch = std::make_shared<batch_type>();
+	std::mutex mtx;
+	std::condition_variable work_cv;
+	std::deque<std::pair<std::shared_ptr<batch_type>, radix_incremental_run<T>*>> jobs;
+	bool stopping = false;
+	std::vector<std::thread> workers;
+	std::vector<std::future<void>> callbacks;
+};
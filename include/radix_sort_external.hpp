@@ -0,0 +1,350 @@
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "radix_sort.hpp"
+
+// ----------------------------------------------
+// External radix sort of files of fixed-width records (POSIX)
+// The input is read through mmap and split on its top digit into temporary bucket files written in large blocks.
+// Buckets that fit the memory budget are sorted in memory with radix_sorter and appended to the output in order,
+// larger ones are split again, so the file may be much larger than memory.
+// ----------------------------------------------
+struct radix_external_options
+{
+	std::size_t memory_budget = std::size_t(1) << 30;	//records, scratch and write blocks held at once, page cache aside
+	unsigned int max_open_files = 64;				//including the input and output, at least 4
+	std::string temp_dir = std::filesystem::temp_directory_path().string();	//bucket files are removed as soon as they are read back
+	std::size_t block_size = std::size_t(1) << 20;	//write size of a bucket file, shrunk to fit the budget
+	unsigned int threads = 1;						//sort the buckets with parallel_sort when more than 1
+};
+
+[[noreturn]] inline void radix_external_error(const char* what)
+{
+	throw std::system_error(errno, std::generic_category(), what);
+}
+
+//Owned file descriptor
+class radix_file
+{
+public:
+	radix_file() = default;
+	explicit radix_file(int fd) noexcept : fd(fd) {}
+	radix_file(radix_file&& other) noexcept : fd(std::exchange(other.fd, -1)) {}
+	radix_file& operator=(radix_file&& other) noexcept
+	{
+		std::swap(fd, other.fd);
+		return *this;
+	}
+	~radix_file()
+	{
+		if (fd >= 0)
+			::close(fd);
+	}
+
+	int get() const noexcept
+	{
+		return fd;
+	}
+
+	void write(const void* data, std::size_t bytes)
+	{
+		auto p = static_cast<const char*>(data);
+		while (bytes != 0)
+		{
+			auto n = ::write(fd, p, bytes);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				radix_external_error("radix_sort_external: write");
+			p += n;
+			bytes -= size_t(n);
+		}
+	}
+
+	void read(void* data, std::size_t bytes, std::size_t offset = 0)
+	{
+		auto p = static_cast<char*>(data);
+		while (bytes != 0)
+		{
+			auto n = ::pread(fd, p, bytes, off_t(offset));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				radix_external_error("radix_sort_external: read");
+			p += n;
+			offset += size_t(n);
+			bytes -= size_t(n);
+		}
+	}
+
+private:
+	int fd = -1;
+};
+
+//Read-only mapping of the first length records of a file
+template <typename T>
+class radix_mapping
+{
+public:
+	radix_mapping(int fd, std::size_t length) : length(length)
+	{
+		if (length == 0)
+			return;
+		addr = ::mmap(nullptr, length * sizeof(T), PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr == MAP_FAILED)
+			radix_external_error("radix_sort_external: mmap");
+		::madvise(addr, length * sizeof(T), MADV_SEQUENTIAL);
+	}
+	radix_mapping(const radix_mapping&) = delete;
+	radix_mapping& operator=(const radix_mapping&) = delete;
+	~radix_mapping()
+	{
+		if (length != 0)
+			::munmap(addr, length * sizeof(T));
+	}
+
+	const T* data() const noexcept
+	{
+		return static_cast<const T*>(addr);
+	}
+
+private:
+	void* addr = nullptr;
+	std::size_t length;
+};
+
+//Bucket file in temp_dir, removed once it is opened for reading or dropped
+class radix_temp_file
+{
+public:
+	explicit radix_temp_file(const std::string& dir) : path(dir + "/radix_sort_XXXXXX")
+	{
+		int fd = ::mkstemp(path.data());
+		if (fd < 0)
+			radix_external_error("radix_sort_external: mkstemp");
+		file = radix_file(fd);
+	}
+	radix_temp_file(radix_temp_file&& other) noexcept
+		: path(std::exchange(other.path, std::string())), file(std::move(other.file)) {}
+	radix_temp_file& operator=(radix_temp_file&&) = delete;
+	~radix_temp_file()
+	{
+		if (!path.empty())
+			::unlink(path.c_str());
+	}
+
+	radix_file& writer() noexcept
+	{
+		return file;
+	}
+
+	//Close the writer, keeping the file for open()
+	void close() noexcept
+	{
+		file = radix_file();
+	}
+
+	//The data stays reachable through the returned descriptor only
+	radix_file open()
+	{
+		radix_file reader(::open(path.c_str(), O_RDONLY));
+		if (reader.get() < 0)
+			radix_external_error("radix_sort_external: open");
+		::unlink(path.c_str());
+		path.clear();
+		return reader;
+	}
+
+private:
+	std::string path;
+	radix_file file;
+};
+
+template <typename T, typename Trait>
+struct radix_external_context
+{
+	const radix_external_options& opt;
+	radix_file& output;
+	std::size_t max_groups;	//bucket files open while a file is split
+	std::size_t block;		//records per bucket write
+	std::size_t capacity;	//records sorted in memory, as many again go to the scratch buffer
+	radix_sorter<T, Trait>& sorter;
+	std::vector<T>& chunk;
+};
+
+//Sort a file that fits in memory and append it to the output
+template <typename T, typename Trait>
+void external_radix_sort_chunk(radix_external_context<T, Trait>& ctx, radix_file input, std::size_t length)
+{
+	auto& chunk = ctx.chunk;
+	chunk.resize(length);
+	input.read(chunk.data(), length * sizeof(T));
+	if (ctx.opt.threads > 1)
+		ctx.sorter.parallel_sort(chunk.begin(), chunk.end());
+	else
+		ctx.sorter.sort(chunk.begin(), chunk.end());
+	ctx.output.write(chunk.data(), length * sizeof(T));
+}
+
+//Bucket of every digit value and the number of buckets. Consecutive digit values are packed into buckets of up to
+//capacity records, a larger digit value gets a bucket of its own. When that takes more than max_groups buckets the values
+//are spread over max_groups buckets by the midpoints of their records instead, which still splits at least two values apart.
+inline std::size_t radix_external_groups(const std::vector<std::size_t>& count, std::size_t length, std::size_t capacity,
+	std::size_t max_groups, std::vector<unsigned int>& group)
+{
+	std::size_t groups = 0, fill = 0;
+	for (std::size_t d = 0; d < count.size(); ++d)
+	{
+		if (fill != 0 && fill + count[d] > capacity)
+		{
+			++groups;
+			fill = 0;
+		}
+		group[d] = static_cast<unsigned int>(groups);
+		fill += count[d];
+	}
+	if (groups < max_groups)
+		return groups + 1;
+	std::size_t before = 0;
+	for (std::size_t d = 0; d < count.size(); ++d)
+	{
+		group[d] = static_cast<unsigned int>(std::min(max_groups - 1, (2 * before + count[d]) * max_groups / (2 * length)));
+		before += count[d];
+	}
+	return max_groups;
+}
+
+template <size_t i, typename T, typename Trait>
+void external_radix_level(radix_external_context<T, Trait>& ctx, radix_file input, std::size_t length);
+
+//Continue with the digit below i once every record has the same digit i
+template <size_t i, typename T, typename Trait>
+void external_radix_next(radix_external_context<T, Trait>& ctx, radix_file input, std::size_t length)
+{
+	if constexpr (i > 0)
+		external_radix_level<i - 1>(ctx, std::move(input), length);
+	else
+	{
+		//all keys are equal
+		radix_mapping<T> records(input.get(), length);
+		ctx.output.write(records.data(), length * sizeof(T));
+	}
+}
+
+//Split a file on digit i into bucket files and sort them in order, the buckets have fewer digit values than the file
+template <size_t i, typename T, typename Trait>
+void external_radix_level(radix_external_context<T, Trait>& ctx, radix_file input, std::size_t length)
+{
+	using namespace std;
+	if (length <= ctx.capacity)
+		return external_radix_sort_chunk(ctx, std::move(input), length);
+
+	vector<radix_temp_file> files;
+	vector<size_t> count(radix_count_v<Trait>), size, values;
+	vector<unsigned int> group(radix_count_v<Trait>);
+	{
+		radix_mapping<T> records(input.get(), length);
+		auto data = records.data();
+		for (size_t k = 0; k < length; ++k)
+			++count[Trait::template get<i>(data[k])];
+	}
+	if (*max_element(count.begin(), count.end()) == length)
+		return external_radix_next<i>(ctx, std::move(input), length);
+	{
+		radix_mapping<T> records(input.get(), length);
+		auto data = records.data();
+		input = radix_file(); //the mapping keeps it readable
+
+		auto groups = radix_external_groups(count, length, ctx.capacity, ctx.max_groups, group);
+		size.assign(groups, 0);
+		values.assign(groups, 0);
+		for (size_t d = 0; d < count.size(); ++d)
+		{
+			size[group[d]] += count[d];
+			values[group[d]] += count[d] != 0;
+		}
+		vector<vector<T>> blocks(groups);
+		for (size_t g = 0; g < groups; ++g)
+		{
+			files.emplace_back(ctx.opt.temp_dir);
+			blocks[g].reserve(min(ctx.block, size[g]));
+		}
+		for (size_t k = 0; k < length; ++k)
+		{
+			auto g = group[Trait::template get<i>(data[k])];
+			auto& block = blocks[g];
+			block.push_back(data[k]);
+			if (block.size() == ctx.block)
+			{
+				files[g].writer().write(block.data(), block.size() * sizeof(T));
+				block.clear();
+			}
+		}
+		for (size_t g = 0; g < groups; ++g)
+		{
+			files[g].writer().write(blocks[g].data(), blocks[g].size() * sizeof(T));
+			files[g].close();
+		}
+	}
+
+	for (size_t g = 0; g < files.size(); ++g)
+	{
+		if (size[g] == 0)
+			continue;
+		auto bucket = files[g].open();
+		if (size[g] <= ctx.capacity)
+			external_radix_sort_chunk(ctx, std::move(bucket), size[g]);
+		else if (values[g] == 1)
+			external_radix_next<i>(ctx, std::move(bucket), size[g]);
+		else
+			external_radix_level<i>(ctx, std::move(bucket), size[g]);
+	}
+}
+
+//Sort the records of type T in the file input into the file output, which must be a different file.
+//Memory stays within opt.memory_budget besides the page cache of the mapped files, and at most opt.max_open_files
+//files are open at once. Throws std::system_error when a file operation fails.
+template <typename T, typename Trait = radix_trait<T>>
+void external_radix_sort(const std::string& input, const std::string& output, const radix_external_options& opt = {})
+{
+	using namespace std;
+	static_assert(is_trivially_copyable_v<T>, "external_radix_sort sorts files of trivially copyable records");
+	if (opt.max_open_files < 4)
+		throw invalid_argument("external_radix_sort: max_open_files must be at least 4");
+
+	radix_file in(::open(input.c_str(), O_RDONLY));
+	if (in.get() < 0)
+		radix_external_error("radix_sort_external: open input");
+	radix_file out(::open(output.c_str(), O_WRONLY | O_CREAT, 0644));
+	if (out.get() < 0)
+		radix_external_error("radix_sort_external: open output");
+	struct stat in_stat, out_stat;
+	if (::fstat(in.get(), &in_stat) != 0 || ::fstat(out.get(), &out_stat) != 0)
+		radix_external_error("radix_sort_external: fstat");
+	if (in_stat.st_dev == out_stat.st_dev && in_stat.st_ino == out_stat.st_ino)
+		throw invalid_argument("external_radix_sort: output must not be the input file");
+	if (size_t(in_stat.st_size) % sizeof(T) != 0)
+		throw invalid_argument("external_radix_sort: input size is not a multiple of the record size");
+	if (::ftruncate(out.get(), 0) != 0)
+		radix_external_error("radix_sort_external: truncate output");
+
+	//the budget is shared by the write blocks of the bucket files and the records sorted in memory with their scratch
+	size_t max_groups = opt.max_open_files - 2;
+	size_t block = max<size_t>(1, min(opt.block_size, opt.memory_budget / (2 * max_groups)) / sizeof(T));
+	size_t capacity = max<size_t>(1, (opt.memory_budget - min(opt.memory_budget, max_groups * block * sizeof(T))) / (2 * sizeof(T)));
+	radix_sorter<T, Trait> sorter(max(1u, opt.threads));
+	vector<T> chunk;
+	radix_external_context<T, Trait> ctx{ opt, out, max_groups, block, capacity, sorter, chunk };
+	external_radix_level<Trait::radix_size - 1>(ctx, std::move(in), size_t(in_stat.st_size) / sizeof(T));
+}